@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * asmcheck.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+/*
+ * Regression check for assemble_parallel(): for every source it has to return what assemble()
+ * returns and write the exact same bytes, on 1, 3 and 8 threads. The sources are the files given
+ * on the command line plus random ones (comments, short lines, negative and missing values,
+ * CRLF, lines longer than the assembler's line buffer and fewer lines than threads).
+ *
+ * gcc -pthread -o dirt-asmcheck src/asmcheck.c src/assembler.c
+ * ./dirt-asmcheck -n [number of random sources] -s [seed] [program.dasm ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "assembler.h"
+
+#define ASMCHECK_MAX_LINES 4096
+
+static const int threadCounts[] = { 1, 3, 8 };
+#define NUM_THREAD_COUNTS ((int) (sizeof(threadCounts) / sizeof(threadCounts[0])))
+
+static const char *mnemonics[] = { "nop", "movl", "stmovl", "addl", "subl",
+		"imul", "idivl", "andl", "orl", "xorl", "shrw", "shlw", "cmpl", "je",
+		"jl", "jg", "jle", "jge", "jmp", "pushl", "popl", "intl", "bogus" };
+static const char *operands[] = { "nop", "int", "a", "b", "c", "d", "err",
+		"stack", "base", "x" };
+#define NUM_MNEMONICS ((int) (sizeof(mnemonics) / sizeof(mnemonics[0])))
+#define NUM_OPERANDS ((int) (sizeof(operands) / sizeof(operands[0])))
+
+static int check_source(FILE *source, const char *name);
+static char* read_file(FILE *file, size_t *size);
+static void write_random_source(FILE *source, uint64_t *state);
+static uint64_t xorshift64(uint64_t *state);
+
+// Usage: dirt-asmcheck -n [number of random sources] -s [seed] [program.dasm ...]
+int main(int argc, char **argv) {
+	long numSources = 200;
+	uint64_t seed = (uint64_t) time(NULL);
+	int numFailed = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			numSources = strtol(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else {
+			FILE *source = fopen(argv[i], "rb");
+			if (source == NULL) {
+				fprintf(stderr, "[asmcheck] Could not open %s\n", argv[i]);
+				return 1;
+			}
+			numFailed += check_source(source, argv[i]) < 0;
+			fclose(source);
+		}
+	}
+
+	printf("[asmcheck] seed: %llu\n", (unsigned long long) seed);
+	uint64_t state = seed == 0 ? 1 : seed;
+	for (long n = 0; n < numSources; n++) {
+		FILE *source = tmpfile();
+		if (source == NULL) {
+			return 1;
+		}
+		write_random_source(source, &state);
+		char name[48];
+		snprintf(name, sizeof(name), "random source %ld", n);
+		numFailed += check_source(source, name) < 0;
+		fclose(source);
+	}
+	printf("[asmcheck] %d mismatches\n", numFailed);
+	return numFailed == 0 ? 0 : 1;
+}
+
+static int check_source(FILE *source, const char *name) {
+	FILE *reference = tmpfile();
+	if (reference == NULL) {
+		return -1;
+	}
+	rewind(source);
+	int referenceResult = assemble(source, reference);
+	size_t referenceSize;
+	char *referenceBytes = read_file(reference, &referenceSize);
+	fclose(reference);
+	if (referenceBytes == NULL) {
+		return -1;
+	}
+
+	int result = 0;
+	for (int i = 0; i < NUM_THREAD_COUNTS; i++) {
+		FILE *hdd = tmpfile();
+		if (hdd == NULL) {
+			result = -1;
+			break;
+		}
+		rewind(source);
+		int parallelResult = assemble_parallel(source, hdd, threadCounts[i]);
+		size_t size;
+		char *bytes = read_file(hdd, &size);
+		fclose(hdd);
+		if (bytes == NULL || parallelResult != referenceResult
+				|| size != referenceSize
+				|| memcmp(bytes, referenceBytes, size) != 0) {
+			fprintf(stderr,
+					"[asmcheck] %s: %d threads returned %d and wrote %zu bytes, assemble() returned %d and wrote %zu bytes\n",
+					name, threadCounts[i], parallelResult, size,
+					referenceResult, referenceSize);
+			result = -1;
+		}
+		free(bytes);
+	}
+	free(referenceBytes);
+	return result;
+}
+
+static char* read_file(FILE *file, size_t *size) {
+	if (fseek(file, 0, SEEK_END) != 0) {
+		return NULL;
+	}
+	long length = ftell(file);
+	rewind(file);
+	char *bytes = malloc(length > 0 ? length : 1);
+	if (length < 0 || bytes == NULL
+			|| fread(bytes, 1, length, file) != (size_t) length) {
+		free(bytes);
+		return NULL;
+	}
+	*size = length;
+	return bytes;
+}
+
+static void write_random_source(FILE *source, uint64_t *state) {
+	// Mostly small sources so there are chunks with nothing in them, some big enough for all threads
+	long numLines = xorshift64(state) % 4 == 0 ?
+			xorshift64(state) % ASMCHECK_MAX_LINES : xorshift64(state) % 16;
+	fprintf(source, ".exe %ld\n", numLines);
+	for (long i = 0; i < numLines; i++) {
+		const char *newline = xorshift64(state) % 8 == 0 ? "\r\n" : "\n";
+		switch (xorshift64(state) % 16) {
+		case 0:
+			fprintf(source, "// comment %ld%s", i, newline);
+			break;
+		case 1:
+			fputs(newline, source); // blank line
+			break;
+		case 2:
+			fprintf(source, "jmp%s", newline); // too short to be code
+			break;
+		case 3: {
+			// Longer than what fgets() hands out at once
+			long length = 990 + xorshift64(state) % 40;
+			fputs("movl a int ", source);
+			for (long j = 0; j < length; j++) {
+				fputc('1' + j % 9, source);
+			}
+			fputs(newline, source);
+			break;
+		}
+		case 4:
+			// Missing fields
+			fprintf(source, "%s %s%s", mnemonics[xorshift64(state) % NUM_MNEMONICS],
+					operands[xorshift64(state) % NUM_OPERANDS], newline);
+			break;
+		default: {
+			long value = (long) (xorshift64(state) % 512) - 256;
+			if (xorshift64(state) % 8 == 0) {
+				value = (long) xorshift64(state); // wider than 32 bits
+			}
+			fprintf(source, "%s\t%s  %s %ld%s",
+					mnemonics[xorshift64(state) % NUM_MNEMONICS],
+					operands[xorshift64(state) % NUM_OPERANDS],
+					operands[xorshift64(state) % NUM_OPERANDS], value, newline);
+			break;
+		}
+		}
+	}
+	// Sometimes a line that's only whitespace (an error) or no newline at the very end
+	if (xorshift64(state) % 16 == 0) {
+		fputs("        \n", source);
+	}
+	if (xorshift64(state) % 4 == 0) {
+		fputs("intl nop int 2", source);
+	}
+}
+
+static uint64_t xorshift64(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
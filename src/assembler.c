@@ -28,10 +28,34 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
+#include <pthread.h>
 
 #include "emulator.h"
 #include "assembler.h"
 
+#define MAX_LINE_SIZE 1000
+#define MAX_TOKEN_SIZE 50
+#define MAX_ENCODED_LINE_SIZE (4 * (sizeof(unsigned long) * 2 + 1))
+
+typedef struct {
+	const char *start, *end; // newline aligned piece of the source
+	char *output;
+	size_t outputSize, outputCapacity;
+	long numLines; // encoded lines in output
+	int result;
+} chunk_t;
+
+static bool is_code_line(const char *line, size_t length);
+static int encode_line(const char *line, size_t length, char *out);
+static size_t next_token(const char *line, size_t length, size_t *pos,
+		char *token);
+static size_t put_hex(unsigned long value, char *out);
+static void put_last_line_offset(FILE *hdd, long headerStart, int headerSize,
+		long lastLineOffset, long size);
+static void* encode_chunk(void *arg);
+static char* read_all(FILE *input, size_t *size);
+
 static unsigned long opcodeToHex(char *opcode);
 static unsigned long regToHex(char *reg);
 static unsigned long typeToHex(char *type);
@@ -63,26 +87,290 @@ int assemble(FILE *input, FILE *hdd) {
 	char preprocessor[50];
 	long numLines;
 	fscanf(input, "%49s %ld", preprocessor, &numLines);
-	fprintf(hdd, "%08x %08lx %08x %08x ", 0x1, numLines, 0x0, 0x0);
+	long headerStart = ftell(hdd);
+	int headerSize = fprintf(hdd, "%08x %08lx %08x %08x ", 0x1, numLines,
+			0x0, 0x0);
 
+	long size = headerSize, numWritten = 0, lastLineOffset = 0;
 	while (!feof(input)) {
-		char stream[1000];
-		char opcode[50], reg[50], type[50], val[50];
-		char *memCheck = fgets(stream, 1000, input);
-		if (memCheck == NULL || stream[0] == '/' || strlen(stream) < 5) {
+		char stream[MAX_LINE_SIZE];
+		char encoded[MAX_ENCODED_LINE_SIZE];
+		char *memCheck = fgets(stream, MAX_LINE_SIZE, input);
+		if (memCheck == NULL || !is_code_line(stream, strlen(stream))) {
 			continue;
 		}
-		if (sscanf(stream, "%49s %49s %49s %49s", opcode, reg, type, val) == EOF) {
+		int lineSize = encode_line(stream, strlen(stream), encoded);
+		if (lineSize < 0
+				|| fwrite(encoded, 1, lineSize, hdd) != (size_t) lineSize) {
 			return -1;
 		}
-		if (fprintf(hdd, "%08lx %08lx %08lx %08lx ", opcodeToHex(opcode),
-				regToHex(reg), typeToHex(type), valToHex(val)) < 0) {
-			return -1;
+		if (++numWritten == numLines) {
+			lastLineOffset = size;
 		}
+		size += lineSize;
 	}
+	put_last_line_offset(hdd, headerStart, headerSize, lastLineOffset, size);
 	return 0;
 }
 
+int assemble_parallel(FILE *input, FILE *hdd, int numThreads) {
+	size_t size;
+	char *source = read_all(input, &size);
+	if (source == NULL) {
+		return -1;
+	}
+
+	char preprocessor[MAX_TOKEN_SIZE];
+	long numLines;
+	int headerSize = 0;
+	if (sscanf(source, "%49s %ld%n", preprocessor, &numLines, &headerSize) < 2) {
+		free(source);
+		return -1;
+	}
+	long hddStart = ftell(hdd);
+	int hddHeaderSize = fprintf(hdd, "%08x %08lx %08x %08x ", 0x1, numLines,
+			0x0, 0x0);
+
+	if (numThreads < 1) {
+		numThreads = 1;
+	}
+	chunk_t *chunks = calloc(numThreads, sizeof(chunk_t));
+	pthread_t *threads = calloc(numThreads, sizeof(pthread_t));
+	if (chunks == NULL || threads == NULL) {
+		free(chunks);
+		free(threads);
+		free(source);
+		return -1;
+	}
+
+	// Cut the source into roughly equal pieces, always right after a newline
+	const char *end = source + size;
+	const char *start = source + headerSize;
+	for (int i = 0; i < numThreads; i++) {
+		const char *chunkEnd = i == numThreads - 1 ?
+				end : start + (end - start) / (numThreads - i);
+		while (chunkEnd < end && chunkEnd > start && chunkEnd[-1] != '\n') {
+			chunkEnd++;
+		}
+		chunks[i].start = start;
+		chunks[i].end = chunkEnd;
+		start = chunkEnd;
+	}
+
+	int numStarted = 0;
+	for (int i = 1; i < numThreads; i++) {
+		if (pthread_create(&threads[i], NULL, encode_chunk, &chunks[i]) != 0) {
+			break;
+		}
+		numStarted++;
+	}
+	encode_chunk(&chunks[0]);
+	for (int i = 1; i <= numStarted; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	for (int i = numStarted + 1; i < numThreads; i++) {
+		encode_chunk(&chunks[i]); // couldn't get a thread, do it here
+	}
+
+	/*
+	 * Jump targets are absolute line numbers, so the chunks don't depend on each other and
+	 * merging is just writing them out in order (each one in a single fwrite). Like assemble(),
+	 * everything up to a bad line is still written.
+	 */
+	int result = 0;
+	long hddSize = hddHeaderSize, numWritten = 0, lastLineOffset = 0;
+	for (int i = 0; i < numThreads; i++) {
+		if (fwrite(chunks[i].output, 1, chunks[i].outputSize, hdd)
+				!= chunks[i].outputSize || chunks[i].result < 0) {
+			result = -1;
+			break;
+		}
+		if (lastLineOffset == 0 && numLines > numWritten
+				&& numLines <= numWritten + chunks[i].numLines) {
+			// Every encoded line is 4 words, each one ends with a space
+			long spaces = (numLines - numWritten - 1) * 4;
+			size_t pos = 0;
+			while (spaces > 0) {
+				spaces -= chunks[i].output[pos++] == ' ';
+			}
+			lastLineOffset = hddSize + pos;
+		}
+		numWritten += chunks[i].numLines;
+		hddSize += chunks[i].outputSize;
+	}
+	if (result == 0) {
+		put_last_line_offset(hdd, hddStart, hddHeaderSize, lastLineOffset,
+				hddSize);
+	}
+
+	for (int i = 0; i < numThreads; i++) {
+		free(chunks[i].output);
+	}
+	free(chunks);
+	free(threads);
+	free(source);
+	return result;
+}
+
+// Comments and (almost) empty lines are skipped
+static bool is_code_line(const char *line, size_t length) {
+	return length >= 5 && line[0] != '/';
+}
+
+/*
+ * Writes "[opcode] [register] [type] [value] " in hex to out and returns how many bytes that was,
+ * or -1 if the line is only whitespace. Missing fields become -1 (an invalid value).
+ */
+static int encode_line(const char *line, size_t length, char *out) {
+	char opcode[MAX_TOKEN_SIZE] = "", reg[MAX_TOKEN_SIZE] = "",
+			type[MAX_TOKEN_SIZE] = "", val[MAX_TOKEN_SIZE] = "";
+	size_t pos = 0;
+	if (next_token(line, length, &pos, opcode) == 0) {
+		return -1;
+	}
+	next_token(line, length, &pos, reg);
+	next_token(line, length, &pos, type);
+	if (next_token(line, length, &pos, val) == 0) {
+		strcpy(val, "-1");
+	}
+
+	size_t size = 0;
+	size += put_hex(opcodeToHex(opcode), out + size);
+	size += put_hex(regToHex(reg), out + size);
+	size += put_hex(typeToHex(type), out + size);
+	size += put_hex(valToHex(val), out + size);
+	return (int) size;
+}
+
+// Like sscanf's %49s, but the line doesn't have to be NUL terminated
+static size_t next_token(const char *line, size_t length, size_t *pos,
+		char *token) {
+	size_t i = *pos;
+	while (i < length && isspace((unsigned char) line[i])) {
+		i++;
+	}
+	size_t tokenSize = 0;
+	while (i < length && tokenSize < MAX_TOKEN_SIZE - 1
+			&& line[i] != '\0' && !isspace((unsigned char) line[i])) {
+		token[tokenSize++] = line[i++];
+	}
+	token[tokenSize] = '\0';
+	*pos = i;
+	return tokenSize;
+}
+
+// Same as printf("%08lx ")
+static size_t put_hex(unsigned long value, char *out) {
+	static const char digits[] = "0123456789abcdef";
+	char reversed[sizeof(unsigned long) * 2];
+	size_t numDigits = 0;
+	do {
+		reversed[numDigits++] = digits[value & 0xf];
+		value >>= 4;
+	} while (value != 0);
+
+	size_t size = 0;
+	for (size_t i = numDigits; i < 8; i++) {
+		out[size++] = '0';
+	}
+	while (numDigits > 0) {
+		out[size++] = reversed[--numDigits];
+	}
+	out[size++] = ' ';
+	return size;
+}
+
+/*
+ * The header's first operand (unused by the loaders) gets where the last instruction starts,
+ * counted from the header, so stream_open() can load it without going through the whole hdd.
+ * Left at 0 when that's not known, or the hdd can't seek
+ */
+static void put_last_line_offset(FILE *hdd, long headerStart, int headerSize,
+		long lastLineOffset, long size) {
+	if (headerStart < 0 || headerSize <= 0 || lastLineOffset <= 0
+			|| (unsigned long) lastLineOffset > 0xffffffffUL) {
+		return;
+	}
+	// The first operand is the third of the four header words, "00000000 00000000 " is what's left
+	if (fseek(hdd, headerStart + headerSize - 18, SEEK_SET) == 0) {
+		fprintf(hdd, "%08lx", (unsigned long) lastLineOffset);
+	}
+	fseek(hdd, headerStart + size, SEEK_SET);
+}
+
+static void* encode_chunk(void *arg) {
+	chunk_t *chunk = arg;
+	chunk->outputCapacity = (chunk->end - chunk->start) * 3
+			+ MAX_ENCODED_LINE_SIZE;
+	chunk->output = malloc(chunk->outputCapacity);
+	if (chunk->output == NULL) {
+		chunk->result = -1;
+		return NULL;
+	}
+
+	const char *line = chunk->start;
+	while (line < chunk->end) {
+		// fgets() in assemble() hands out at most MAX_LINE_SIZE - 1 characters at a time
+		const char *lineEnd = line;
+		while (lineEnd < chunk->end && lineEnd - line < MAX_LINE_SIZE - 1
+				&& *lineEnd++ != '\n') {
+		}
+		size_t length = lineEnd - line;
+		const char *nul = memchr(line, '\0', length);
+		if (nul != NULL) {
+			length = nul - line; // same as strlen() on the fgets() buffer
+		}
+
+		if (is_code_line(line, length)) {
+			if (chunk->outputSize + MAX_ENCODED_LINE_SIZE
+					> chunk->outputCapacity) {
+				size_t capacity = chunk->outputCapacity * 2;
+				char *output = realloc(chunk->output, capacity);
+				if (output == NULL) {
+					chunk->result = -1;
+					return NULL;
+				}
+				chunk->output = output;
+				chunk->outputCapacity = capacity;
+			}
+			int size = encode_line(line, length, chunk->output + chunk->outputSize);
+			if (size < 0) {
+				chunk->result = -1;
+				return NULL;
+			}
+			chunk->outputSize += size;
+			chunk->numLines++;
+		}
+		line = lineEnd;
+	}
+	return NULL;
+}
+
+// NUL terminated so the header can go through sscanf()
+static char* read_all(FILE *input, size_t *size) {
+	size_t capacity = 1 << 20;
+	char *buffer = malloc(capacity + 1);
+	*size = 0;
+	while (buffer != NULL) {
+		*size += fread(buffer + *size, 1, capacity - *size, input);
+		if (*size < capacity) {
+			if (ferror(input)) {
+				break;
+			}
+			buffer[*size] = '\0';
+			return buffer;
+		}
+		capacity *= 2;
+		char *grown = realloc(buffer, capacity + 1);
+		if (grown == NULL) {
+			break;
+		}
+		buffer = grown;
+	}
+	free(buffer);
+	return NULL;
+}
+
 static unsigned long opcodeToHex(char *opcode) {
 	for (int i = 0; i < 22; i++) {
 		if (strcmp(opcode, opcodes[i]) == 0) {
@@ -27,6 +27,25 @@
 #ifndef ASSEMBLER_H_
 #define ASSEMBLER_H_
 
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Writes the hdd image of the source. If hdd can seek, the header's first operand gets the byte
+ * offset of the last instruction (from the start of the header), see stream_open()
+ */
 int assemble(FILE *input, FILE *hdd);
+/*
+ * Same output as assemble(), but the source is read in one go and split into chunks that are
+ * encoded on numThreads threads. Meant for very big (generated) sources
+ */
+int assemble_parallel(FILE *input, FILE *hdd, int numThreads);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* ASSEMBLER_H_ */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * compress.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compress.h"
+
+static size_t put_varint(unsigned long value, unsigned char *dest);
+static int get_varint(const unsigned char *src, size_t srcSize, size_t *pos,
+		unsigned long *value);
+
+size_t compress_words(const long *words, long numWords, unsigned char *dest) {
+	size_t size = 0;
+	long i = 0;
+	while (i < numWords) {
+		if (words[i] == 0) {
+			long run = 1;
+			while (i + run < numWords && words[i + run] == 0) {
+				run++;
+			}
+			size += put_varint(0, dest + size);
+			size += put_varint(run, dest + size);
+			i += run;
+		} else {
+			// zigzag so small negative numbers stay small
+			unsigned long zigzag = ((unsigned long) words[i] << 1)
+					^ (unsigned long) (words[i] >> (sizeof(long) * 8 - 1));
+			size += put_varint(zigzag, dest + size);
+			i++;
+		}
+	}
+	return size;
+}
+
+long decompress_words(const unsigned char *src, size_t srcSize, long *dest,
+		long maxWords) {
+	size_t pos = 0;
+	long numWords = 0;
+	while (pos < srcSize) {
+		unsigned long value;
+		if (get_varint(src, srcSize, &pos, &value) < 0) {
+			return -1;
+		}
+		if (value == 0) {
+			unsigned long run;
+			if (get_varint(src, srcSize, &pos, &run) < 0
+					|| run > (unsigned long) (maxWords - numWords)) {
+				return -1;
+			}
+			memset(dest + numWords, 0, run * sizeof(long));
+			numWords += run;
+		} else {
+			if (numWords >= maxWords) {
+				return -1;
+			}
+			dest[numWords++] = (long) ((value >> 1) ^ (0UL - (value & 1)));
+		}
+	}
+	return numWords;
+}
+
+static size_t put_varint(unsigned long value, unsigned char *dest) {
+	size_t size = 0;
+	while (value >= 0x80) {
+		dest[size++] = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	dest[size++] = (unsigned char) value;
+	return size;
+}
+
+static int get_varint(const unsigned char *src, size_t srcSize, size_t *pos,
+		unsigned long *value) {
+	unsigned long result = 0;
+	for (unsigned int shift = 0; shift < sizeof(long) * 8; shift += 7) {
+		if (*pos >= srcSize) {
+			return -1;
+		}
+		unsigned char byte = src[(*pos)++];
+		result |= (unsigned long) (byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return 0;
+		}
+	}
+	return -1;
+}
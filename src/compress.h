@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * compress.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Block codec for memory images: every word is a zigzag varint and runs of zeros are stored
+ * as a zero followed by the run length, so mostly empty memory and small instruction fields
+ * shrink a lot and decoding is a single pass straight into the destination.
+ */
+
+// Biggest possible output of compress_words() for numWords words
+#define COMPRESS_BOUND(numWords) ((size_t) (numWords) * 10)
+
+/*
+ * Returns the number of bytes written to dest (dest must hold COMPRESS_BOUND(numWords) bytes)
+ */
+size_t compress_words(const long *words, long numWords, unsigned char *dest);
+/*
+ * Returns the number of words written to dest or -1 if src is corrupt or doesn't fit in maxWords
+ */
+long decompress_words(const unsigned char *src, size_t srcSize, long *dest,
+		long maxWords);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPRESS_H_ */
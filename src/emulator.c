@@ -27,19 +27,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <limits.h>
 
 #include "emulator.h"
+#include "stream.h"
+#include "timing.h"
+#include "profiler.h"
 
 static int programToMem(emulator_t *emu);
+static void load_instruction(unsigned long opcode, unsigned long reg,
+		unsigned long type, unsigned long val, emulator_t *emu);
+static int next_hex_word(const char *image, size_t imageSize, size_t *pos,
+		unsigned long *word);
+
+static void print_trace(long opcode, long reg, long type, long val,
+		emulator_t *emu);
+static void cpu_fault(long code, const char *where, long *errReg,
+		bool isQuiet);
 
 static void movl(long *reg, long value);
 static void stmovl(long *reg, long value, long *stack, long stackSize,
-		long *errReg);
+		long *errReg, bool isQuiet);
 
 static void addl(long *reg, long value);
 static void subl(long *reg, long value);
 static void imul(long *reg, long value);
-static void idivl(long *reg, long value);
+static void idivl(long *reg, long value, long *errReg, bool isQuiet);
 
 static void andl(long *reg, long value);
 static void orl(long *reg, long value);
@@ -55,11 +69,12 @@ static int jle(long lineNum, long x_special_reg, long *instructionCounter);
 static int jge(long lineNum, long x_special_reg, long *instructionCounter);
 static void jmp(long lineNum, long *instructionCounter);
 
-static void intl(long value, long *errReg, bool *isRunning, emulator_t *emu);
+static void intl(long value, long *errReg, bool *isHalted, emulator_t *emu);
+static void read_perf_counters(emulator_t *emu);
 static void pushl(long value, long *specialMemArr, long *specialMemCounter,
-		long ramSize, long *errReg);
+		long ramSize, long *errReg, bool isQuiet);
 static void popl(long *regPtr, long *errReg, long *specialMemArr,
-		long *specialMemCounter);
+		long *specialMemCounter, bool isQuiet);
 
 static long* get_reg_ptr(long reg, emulator_t *emu);
 static long get_value_on_type(long type, long val, emulator_t *emu);
@@ -72,20 +87,131 @@ static long get_value_on_type(long type, long val, emulator_t *emu);
 int emulator_init(long stackSize, FILE *hdd, emulator_t *emu) {
 	// RAM
 	emu->stack = malloc(stackSize * sizeof(long));
-	emu->specialMem = malloc(stackSize / 2 * sizeof(long));
+	emu->specialMem = malloc(
+			EMULATOR_SPECIAL_MEM_SIZE(stackSize) * sizeof(long));
 	if (emu->stack == NULL || emu->specialMem == NULL) {
 		return -1;
 	}
-	emu->specialMemCounter = -1;
 	emu->stackSize = stackSize;
+	emu->ownsMem = true;
 	emu->hdd = hdd;
+	emu->stream = NULL;
+	emu->timing = NULL;
+	emu->sample = NULL;
+	emu->console = stdout;
+	emu->isQuiet = false;
+	emulator_reset(emu);
+
+	return 0;
+}
+
+int emulator_init_mem(long stackSize, long *stack, long *specialMem,
+		emulator_t *emu) {
+	if (stack == NULL || specialMem == NULL) {
+		return -1;
+	}
+	emu->stack = stack;
+	emu->specialMem = specialMem;
+	emu->stackSize = stackSize;
+	emu->ownsMem = false;
+	emu->hdd = NULL;
+	emu->stream = NULL;
+	emu->timing = NULL;
+	emu->sample = NULL;
+	emu->console = stdout;
+	emu->isQuiet = false;
+	emulator_reset(emu);
 
 	return 0;
 }
 
 void emulator_free(emulator_t *emu) {
-	free(emu->stack);
-	free(emu->specialMem);
+	stream_close(emu);
+	if (emu->ownsMem) {
+		free(emu->stack);
+		free(emu->specialMem);
+	}
+	emu->stack = NULL;
+	emu->specialMem = NULL;
+}
+
+void emulator_reset(emulator_t *emu) {
+	stream_close(emu);
+	if (emu->hdd != NULL) {
+		rewind(emu->hdd); // so the program can be loaded again
+	}
+	emu->nop_reg = emu->a_reg = emu->b_reg = emu->c_reg = emu->d_reg = 0;
+	emu->err_reg = emu->stack_reg = emu->base_reg = 0;
+	emu->x_special_reg = 0;
+
+	memset(emu->stack, 0, emu->stackSize * sizeof(long));
+	memset(emu->specialMem, 0,
+			EMULATOR_SPECIAL_MEM_SIZE(emu->stackSize) * sizeof(long));
+	emu->specialMemCounter = -1;
+
+	emu->instructionCounter = 0;
+	emu->instructionsRetired = 0;
+	if (emu->timing != NULL) {
+		timing_reset(emu->timing);
+	}
+	emu->isLoaded = false;
+	emu->isHalted = false;
+}
+
+int emulator_load_hdd(emulator_t *emu) {
+	if (emu->hdd == NULL) {
+		return -1;
+	}
+	if (programToMem(emu) != 0) {
+		return -1; // isLoaded stays false so nothing treats half a program as loaded
+	}
+	emu->isLoaded = true;
+	return 0;
+}
+
+int emulator_load_image(const char *image, size_t imageSize, emulator_t *emu) {
+	size_t pos = 0;
+	unsigned long operation, numLines, operand1, operand2;
+	if (next_hex_word(image, imageSize, &pos, &operation) < 0
+			|| next_hex_word(image, imageSize, &pos, &numLines) < 0
+			|| next_hex_word(image, imageSize, &pos, &operand1) < 0
+			|| next_hex_word(image, imageSize, &pos, &operand2) < 0) {
+		return -1;
+	}
+	if (numLines > (unsigned long) emu->stackSize / 4) {
+		return -1; // same limit as emulator_load_words(), checked before anything is written
+	}
+
+	for (long lineCounter = 1; lineCounter <= (long) numLines; lineCounter++) {
+		unsigned long opcode, reg, type, val;
+		if (next_hex_word(image, imageSize, &pos, &opcode) < 0
+				|| next_hex_word(image, imageSize, &pos, &reg) < 0
+				|| next_hex_word(image, imageSize, &pos, &type) < 0
+				|| next_hex_word(image, imageSize, &pos, &val) < 0) {
+			return -1;
+		}
+		load_instruction(opcode, reg, type, val, emu);
+	}
+	if (emu->err_reg != 0) {
+		return -1; // like emulator_load_hdd(), a fault leaves isLoaded false
+	}
+	emu->isLoaded = true;
+	return 0;
+}
+
+int emulator_load_words(const long *words, long numLines, emulator_t *emu) {
+	if (numLines < 0 || numLines * 4 > emu->stackSize) {
+		return -1;
+	}
+	for (long i = 0; i < numLines * 4; i += 4) {
+		load_instruction(words[i], words[i + 1], words[i + 2], words[i + 3],
+				emu);
+	}
+	if (emu->err_reg != 0) {
+		return -1;
+	}
+	emu->isLoaded = true;
+	return 0;
 }
 
 int emulator_create_hdd(long hddSize, FILE *hdd) {
@@ -118,19 +244,56 @@ int emulator_flash_pgrm_to_hdd(long location, FILE *pgrm, FILE *hdd) {
 int emulator_start(emulator_t *emu) {
 	movl(&emu->nop_reg, 0);
 	emu->instructionCounter = 0;
-	programToMem(emu);
+	if (!emu->isLoaded) {
+		if (emu->hdd == NULL) {
+			return -1;
+		}
+		if (emulator_load_hdd(emu) != 0) {
+			return -1; // don't run whatever happens to be in memory
+		}
+	}
+	emu->isHalted = false;
 
-	bool isRunning = true;
-	while (isRunning) {
+	return emulator_run(emu, -1) < 0 ? -1 : 0;
+}
+
+int emulator_run(emulator_t *emu, long maxInstructions) {
+	long executed = 0;
+	long lastPc = emu->instructionCounter, lastOpcode = NOP_INSTR; // for the profiler
+	while (!emu->isHalted && (maxInstructions < 0 || executed < maxInstructions)) {
+		if (emu->instructionCounter < 0
+				|| emu->instructionCounter + 3 >= emu->stackSize) {
+			cpu_fault(SEGMENTATION_FAULT, "emulator_run", &emu->err_reg,
+					emu->isQuiet);
+			emu->isHalted = true;
+			return -1;
+		}
+		if (emu->stream != NULL
+				&& stream_fault(emu->stream, emu->instructionCounter, 4) < 0) {
+			cpu_fault(SEGMENTATION_FAULT, "emulator_run", &emu->err_reg,
+					emu->isQuiet);
+			emu->isHalted = true;
+			return -1;
+		}
+
+		long pc = emu->instructionCounter;
 		long opcode, reg, type, val;
 		opcode = emu->stack[emu->instructionCounter];
 		reg = emu->stack[emu->instructionCounter + 1];
 		type = emu->stack[emu->instructionCounter + 2];
 		val = emu->stack[emu->instructionCounter + 3];
 
+		lastPc = pc;
+		lastOpcode = opcode;
+
 		long *regPtr = get_reg_ptr(reg, emu);
 		long value = get_value_on_type(type, val, emu);
 		long *errReg = &emu->err_reg;
+		long target = value; // jumps count lines from 1
+		subl(&target, 1);
+		bool isTaken = false;
+		executed++;
+		emu->instructionsRetired++;
 
 		switch (opcode) {
 		case NOP_INSTR:
@@ -139,7 +302,14 @@ int emulator_start(emulator_t *emu) {
 			movl(regPtr, value);
 			break;
 		case STMOVL_INSTR:
-			stmovl(regPtr, value, emu->stack, emu->stackSize, errReg);
+			// Page in the target first or the streamed code would overwrite it later
+			if (emu->stream != NULL && value >= 0 && value < emu->stackSize
+					&& stream_fault(emu->stream, value, 1) < 0) {
+				cpu_fault(STMOVL_INSTR, "stmovl", errReg, emu->isQuiet);
+				break;
+			}
+			stmovl(regPtr, value, emu->stack, emu->stackSize, errReg,
+					emu->isQuiet);
 			break;
 		case ADDL_INSTR:
 			addl(regPtr, value);
@@ -151,7 +321,7 @@ int emulator_start(emulator_t *emu) {
 			imul(regPtr, value);
 			break;
 		case IDIVL_INSTR:
-			idivl(regPtr, value);
+			idivl(regPtr, value, errReg, emu->isQuiet);
 			break;
 		case ANDL_INSTR:
 			andl(regPtr, value);
@@ -172,70 +342,100 @@ int emulator_start(emulator_t *emu) {
 			cmpl(regPtr, value, &emu->x_special_reg);
 			break;
 		case JE_INSTR:
-			if (je(value - 1, emu->x_special_reg, &emu->instructionCounter))
-				continue;
+			isTaken = je(target, emu->x_special_reg,
+					&emu->instructionCounter);
 			break;
 		case JL_INSTR:
-			if (jl(value - 1, emu->x_special_reg, &emu->instructionCounter))
-				continue;
+			isTaken = jl(target, emu->x_special_reg,
+					&emu->instructionCounter);
 			break;
 		case JG_INSTR:
-			if (jg(value - 1, emu->x_special_reg, &emu->instructionCounter))
-				continue;
+			isTaken = jg(target, emu->x_special_reg,
+					&emu->instructionCounter);
 			break;
 		case JLE_INSTR:
-			if (jle(value - 1, emu->x_special_reg, &emu->instructionCounter))
-				continue;
+			isTaken = jle(target, emu->x_special_reg,
+					&emu->instructionCounter);
 			break;
 		case JGE_INSTR:
-			if (jge(value - 1, emu->x_special_reg, &emu->instructionCounter))
-				continue;
+			isTaken = jge(target, emu->x_special_reg,
+					&emu->instructionCounter);
 			break;
 		case JMP_INSTR:
-			jmp(value - 1, &emu->instructionCounter);
-			continue;
+			jmp(target, &emu->instructionCounter);
+			isTaken = true;
+			break;
 		case INTL_INSTR:
-			intl(value, errReg, &isRunning, emu);
+			intl(value, errReg, &emu->isHalted, emu);
 			break;
 		case PUSHL_INSTR:
 			pushl(value, emu->specialMem, &emu->specialMemCounter,
-					emu->stackSize, errReg);
+					emu->stackSize, errReg, emu->isQuiet);
 			break;
 		case POPL_INSTR:
-			popl(regPtr, errReg, &emu->specialMem[0], &emu->specialMemCounter);
+			popl(regPtr, errReg, &emu->specialMem[0], &emu->specialMemCounter,
+					emu->isQuiet);
 			break;
 		default:
-			fprintf(stderr, "[Debug] CPU FAULT: 0x%x on emulator_start!\n",
-			SEGMENTATION_FAULT);
-			emu->err_reg = SEGMENTATION_FAULT;
+			cpu_fault(SEGMENTATION_FAULT, "emulator_start", errReg,
+					emu->isQuiet);
 			break;
 		}
+		if (emu->timing != NULL) {
+			timing_account(emu->timing, opcode, pc, isTaken,
+					opcode == STMOVL_INSTR ? value : -1);
+		}
+		if (opcode == INTL_INSTR && value == INT_PERF_COUNTERS_CODE) {
+			read_perf_counters(emu);
+		}
+		// Every jump (taken or not) and interrupt ends a basic block, that's all the profiler gets to see
+		if (emu->sample != NULL
+				&& ((opcode >= JE_INSTR && opcode <= JMP_INSTR)
+						|| opcode == INTL_INSTR)) {
+			profiler_publish(emu->sample, pc, opcode, emu->instructionsRetired);
+		}
+		if (isTaken) {
+			continue;
+		}
 		emu->instructionCounter += 4;
 
-		// A nice view of what is going on behind the scenes
-		printf("Instruction Line: %ld %ld %ld %ld\n", opcode, reg, type, val);
-		printf("--------------\n");
-		printf("A, B, C, D: %ld %ld %ld %ld\n", emu->a_reg, emu->b_reg,
-				emu->c_reg, emu->d_reg);
-		printf("Error, Stack, Base, X Special Reg: %ld %ld %ld %ld\n",
-				emu->err_reg, emu->stack_reg, emu->base_reg,
-				emu->x_special_reg);
-		printf("Instruction Counter: %ld\n", emu->instructionCounter);
-		printf("Memory: ");
-		for (int i = 0; i <= emu->stack_reg; i++) {
-			printf("%ld ", emu->stack[i]);
+		if (!emu->isQuiet) {
+			print_trace(opcode, reg, type, val, emu);
 		}
-		printf("\n");
+	}
+	if (emu->sample != NULL) {
+		profiler_publish(emu->sample, lastPc, lastOpcode,
+				emu->instructionsRetired);
+	}
+	return emu->isHalted ? 0 : 1;
+}
 
-		printf("Special Memory: ");
-		for (int i = 0; i <= emu->specialMemCounter; i++) {
-			printf("%ld ", emu->specialMem[i]);
-		}
-		printf("\n");
-		printf("emu->specialMemCounter: %ld\n", emu->specialMemCounter);
-		printf("--------------\n");
+// A nice view of what is going on behind the scenes
+static void print_trace(long opcode, long reg, long type, long val,
+		emulator_t *emu) {
+	if (emu->stream != NULL) {
+		stream_load_all(emu->stream); // the memory dump reads all of the code
 	}
-	return 0;
+	printf("Instruction Line: %ld %ld %ld %ld\n", opcode, reg, type, val);
+	printf("--------------\n");
+	printf("A, B, C, D: %ld %ld %ld %ld\n", emu->a_reg, emu->b_reg,
+			emu->c_reg, emu->d_reg);
+	printf("Error, Stack, Base, X Special Reg: %ld %ld %ld %ld\n",
+			emu->err_reg, emu->stack_reg, emu->base_reg, emu->x_special_reg);
+	printf("Instruction Counter: %ld\n", emu->instructionCounter);
+	printf("Memory: ");
+	for (long i = 0; i <= emu->stack_reg && i < emu->stackSize; i++) {
+		printf("%ld ", emu->stack[i]);
+	}
+	printf("\n");
+
+	printf("Special Memory: ");
+	for (long i = 0; i <= emu->specialMemCounter; i++) {
+		printf("%ld ", emu->specialMem[i]);
+	}
+	printf("\n");
+	printf("emu->specialMemCounter: %ld\n", emu->specialMemCounter);
+	printf("--------------\n");
 }
 
 static int programToMem(emulator_t *emu) {
@@ -247,60 +447,107 @@ static int programToMem(emulator_t *emu) {
 	}
 
 	long lineCounter = 1;
-	while (lineCounter <= numLines && !feof(emu->hdd)) {
+	while (lineCounter <= (long) numLines && !feof(emu->hdd)) {
 		unsigned long opcode, reg, type, val;
 		if (fscanf(emu->hdd, "%lx %lx %lx %lx", &opcode, &reg, &type,
 				&val) == EOF) {
 			return -1;
 		}
-
-		movl(&emu->a_reg, opcode);
-		movl(&emu->b_reg, reg);
-		movl(&emu->c_reg, type);
-		movl(&emu->d_reg, val);
-
-		addl(&emu->stack_reg, 4);
-		stmovl(&emu->a_reg, emu->stack_reg - 4, emu->stack, emu->stackSize,
-				&emu->err_reg);
-		stmovl(&emu->b_reg, emu->stack_reg - 3, emu->stack, emu->stackSize,
-				&emu->err_reg);
-		stmovl(&emu->c_reg, emu->stack_reg - 2, emu->stack, emu->stackSize,
-				&emu->err_reg);
-		stmovl(&emu->d_reg, emu->stack_reg - 1, emu->stack, emu->stackSize,
-				&emu->err_reg);
+		load_instruction(opcode, reg, type, val, emu);
 		lineCounter++;
 	}
 	return emu->err_reg;
 }
 
+// Every loader goes through here so the registers end up the same no matter where the program came from
+static void load_instruction(unsigned long opcode, unsigned long reg,
+		unsigned long type, unsigned long val, emulator_t *emu) {
+	movl(&emu->a_reg, opcode);
+	movl(&emu->b_reg, reg);
+	movl(&emu->c_reg, type);
+	movl(&emu->d_reg, val);
+
+	addl(&emu->stack_reg, 4);
+	stmovl(&emu->a_reg, emu->stack_reg - 4, emu->stack, emu->stackSize,
+			&emu->err_reg, emu->isQuiet);
+	stmovl(&emu->b_reg, emu->stack_reg - 3, emu->stack, emu->stackSize,
+			&emu->err_reg, emu->isQuiet);
+	stmovl(&emu->c_reg, emu->stack_reg - 2, emu->stack, emu->stackSize,
+			&emu->err_reg, emu->isQuiet);
+	stmovl(&emu->d_reg, emu->stack_reg - 1, emu->stack, emu->stackSize,
+			&emu->err_reg, emu->isQuiet);
+}
+
+// The image isn't NUL terminated, so no sscanf here
+static int next_hex_word(const char *image, size_t imageSize, size_t *pos,
+		unsigned long *word) {
+	size_t i = *pos;
+	while (i < imageSize && (image[i] == ' ' || image[i] == '\n'
+			|| image[i] == '\r' || image[i] == '\t')) {
+		i++;
+	}
+
+	unsigned long result = 0;
+	size_t start = i;
+	for (; i < imageSize; i++) {
+		char c = image[i];
+		if (c >= '0' && c <= '9') {
+			result = (result << 4) | (c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			result = (result << 4) | (c - 'a' + 10);
+		} else if (c >= 'A' && c <= 'F') {
+			result = (result << 4) | (c - 'A' + 10);
+		} else {
+			break;
+		}
+	}
+	if (i == start) {
+		return -1;
+	}
+	*pos = i;
+	*word = result;
+	return 0;
+}
+
+static void cpu_fault(long code, const char *where, long *errReg,
+		bool isQuiet) {
+	if (!isQuiet) {
+		fprintf(stderr, "[Debug] CPU FAULT: 0x%lx on %s()!\n", code, where);
+	}
+	*errReg = code;
+}
+
 static void movl(long *reg, long value) {
 	*reg = value;
 }
 
 static void stmovl(long *reg, long value, long *stack, long stackSize,
-		long *errReg) {
-	if (value >= stackSize) {
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_reg_ptr()!\n",
-				STMOVL_INSTR);
-		*errReg = STMOVL_INSTR;
+		long *errReg, bool isQuiet) {
+	if (value < 0 || value >= stackSize) {
+		cpu_fault(STMOVL_INSTR, "stmovl", errReg, isQuiet);
 		return;
 	}
 	stack[value] = *reg;
 }
 
+// Arithmetic wraps around like real hardware instead of being undefined behavior
 static void addl(long *reg, long value) {
-	*reg += value;
+	*reg = (long) ((unsigned long) *reg + (unsigned long) value);
 }
 
 static void subl(long *reg, long value) {
-	*reg -= value;
+	*reg = (long) ((unsigned long) *reg - (unsigned long) value);
 }
 
 static void imul(long *reg, long value) {
-	*reg *= value;
+	*reg = (long) ((unsigned long) *reg * (unsigned long) value);
 }
 
-static void idivl(long *reg, long value) {
+static void idivl(long *reg, long value, long *errReg, bool isQuiet) {
+	if (value == 0 || (*reg == LONG_MIN && value == -1)) {
+		cpu_fault(IDIVL_INSTR, "idivl", errReg, isQuiet);
+		return;
+	}
 	*reg /= value;
 }
 
@@ -316,12 +563,13 @@ static void xorl(long *reg, long value) {
 	*reg ^= value;
 }
 
+// Only the low bits of the shift count are used (like x86)
 static void shrw(long *reg, long value) {
-	*reg >>= value;
+	*reg >>= value & (sizeof(long) * 8 - 1);
 }
 
 static void shlw(long *reg, long value) {
-	*reg <<= value;
+	*reg = (long) ((unsigned long) *reg << (value & (sizeof(long) * 8 - 1)));
 }
 
 static void cmpl(long *reg, long value, long *x_special_reg) {
@@ -331,7 +579,7 @@ static void cmpl(long *reg, long value, long *x_special_reg) {
 
 static int je(long lineNum, long x_special_reg, long *instructionCounter) {
 	if (x_special_reg == 0) {
-		*instructionCounter = lineNum * 4;
+		*instructionCounter = (long) ((unsigned long) lineNum * 4);
 		return 1;
 	} else {
 		return 0;
@@ -340,7 +588,7 @@ static int je(long lineNum, long x_special_reg, long *instructionCounter) {
 
 static int jl(long lineNum, long x_special_reg, long *instructionCounter) {
 	if (x_special_reg < 0) {
-		*instructionCounter = lineNum * 4;
+		*instructionCounter = (long) ((unsigned long) lineNum * 4);
 		return 1;
 	} else {
 		return 0;
@@ -349,7 +597,7 @@ static int jl(long lineNum, long x_special_reg, long *instructionCounter) {
 
 static int jg(long lineNum, long x_special_reg, long *instructionCounter) {
 	if (x_special_reg > 0) {
-		*instructionCounter = lineNum * 4;
+		*instructionCounter = (long) ((unsigned long) lineNum * 4);
 		return 1;
 	} else {
 		return 0;
@@ -358,7 +606,7 @@ static int jg(long lineNum, long x_special_reg, long *instructionCounter) {
 
 static int jle(long lineNum, long x_special_reg, long *instructionCounter) {
 	if (x_special_reg <= 0) {
-		*instructionCounter = lineNum * 4;
+		*instructionCounter = (long) ((unsigned long) lineNum * 4);
 		return 1;
 	} else {
 		return 0;
@@ -367,7 +615,7 @@ static int jle(long lineNum, long x_special_reg, long *instructionCounter) {
 
 static int jge(long lineNum, long x_special_reg, long *instructionCounter) {
 	if (x_special_reg >= 0) {
-		*instructionCounter = lineNum * 4;
+		*instructionCounter = (long) ((unsigned long) lineNum * 4);
 		return 1;
 	} else {
 		return 0;
@@ -375,35 +623,56 @@ static int jge(long lineNum, long x_special_reg, long *instructionCounter) {
 }
 
 static void jmp(long lineNum, long *instructionCounter) {
-	*instructionCounter = lineNum * 4;
+	*instructionCounter = (long) ((unsigned long) lineNum * 4);
 }
 
 // Interrupt
-static void intl(long value, long *errReg, bool *isRunning, emulator_t *emu) {
+static void intl(long value, long *errReg, bool *isHalted, emulator_t *emu) {
 	switch (value) {
 	case INT_STDOUT_CODE:
 		// a_reg is the pointer to the location in stack, b_reg is the string length
-		for (int i = 0; i < emu->b_reg; i++) {
-			fprintf(stdout, "%c", (char) emu->stack[emu->a_reg + i]);
+		if (emu->a_reg < 0 || emu->b_reg < 0
+				|| emu->b_reg > emu->stackSize - emu->a_reg) {
+			cpu_fault(INTL_INSTR, "intl", errReg, emu->isQuiet);
+			break;
+		}
+		if (emu->stream != NULL
+				&& stream_fault(emu->stream, emu->a_reg, emu->b_reg) < 0) {
+			cpu_fault(INTL_INSTR, "intl", errReg, emu->isQuiet);
+			break;
+		}
+		if (emu->console == NULL) {
+			break;
+		}
+		for (long i = 0; i < emu->b_reg; i++) {
+			fprintf(emu->console, "%c", (char) emu->stack[emu->a_reg + i]);
 		}
 		break;
 	case INT_SYS_EXIT_CODE:
-		*isRunning = false;
+		*isHalted = true;
 		break;
+	case INT_PERF_COUNTERS_CODE:
+		break; // emulator_run() calls read_perf_counters() once this intl has been charged
 	default:
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_reg_ptr()!\n",
-				INTL_INSTR);
-		*errReg = INTL_INSTR;
+		cpu_fault(INTL_INSTR, "intl", errReg, emu->isQuiet);
 		break;
 	}
 }
 
+// Like rdtsc, but for everything the timing model counts (only retired instructions without it).
+// All four include the intl that asked for them
+static void read_perf_counters(emulator_t *emu) {
+	movl(&emu->a_reg, emu->timing != NULL ? emu->timing->cycles : 0);
+	movl(&emu->b_reg, emu->instructionsRetired);
+	movl(&emu->c_reg,
+			emu->timing != NULL ? emu->timing->branchMispredicts : 0);
+	movl(&emu->d_reg, emu->timing != NULL ? emu->timing->cacheMisses : 0);
+}
+
 static void pushl(long value, long *specialMemArr, long *specialMemCounter,
-		long ramSize, long *errReg) {
-	if (*specialMemCounter > ramSize / 2) {
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_reg_ptr()!\n",
-				PUSHL_INSTR);
-		*errReg = PUSHL_INSTR;
+		long ramSize, long *errReg, bool isQuiet) {
+	if (*specialMemCounter + 1 >= EMULATOR_SPECIAL_MEM_SIZE(ramSize)) {
+		cpu_fault(PUSHL_INSTR, "pushl", errReg, isQuiet);
 		return;
 	}
 	*specialMemCounter = *specialMemCounter + 1;
@@ -411,11 +680,9 @@ static void pushl(long value, long *specialMemArr, long *specialMemCounter,
 }
 
 static void popl(long *regPtr, long *errReg, long *specialMemArr,
-		long *specialMemCounter) {
+		long *specialMemCounter, bool isQuiet) {
 	if (*specialMemCounter < 0) {
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_reg_ptr()!\n",
-				POPL_INSTR);
-		*errReg = POPL_INSTR;
+		cpu_fault(POPL_INSTR, "popl", errReg, isQuiet);
 		return;
 	}
 	*regPtr = *(specialMemArr + *specialMemCounter);
@@ -441,9 +708,8 @@ static long* get_reg_ptr(long reg, emulator_t *emu) {
 	case BASE_REG_HEX:
 		return &emu->base_reg;
 	default:
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_reg_ptr()!\n",
-		SEGMENTATION_FAULT);
-		emu->err_reg = SEGMENTATION_FAULT;
+		cpu_fault(SEGMENTATION_FAULT, "get_reg_ptr", &emu->err_reg,
+				emu->isQuiet);
 		return &emu->err_reg; // TODO: replace this with an alternative method because this yields funny results
 	}
 }
@@ -453,29 +719,36 @@ static long* get_reg_ptr(long reg, emulator_t *emu) {
  * get the register that is in val and do stack[val] to get the value of it
  */
 static long get_value_on_type(long type, long val, emulator_t *emu) {
+	long value = val;
 	switch (type) {
 	case NOP_TYPE:
 		return 0;
 	case INTEGER_TYPE:
 		return val;
 	case A_REG_TYPE:
-		return emu->a_reg + val;
+		addl(&value, emu->a_reg);
+		return value;
 	case B_REG_TYPE:
-		return emu->b_reg + val;
+		addl(&value, emu->b_reg);
+		return value;
 	case C_REG_TYPE:
-		return emu->c_reg + val;
+		addl(&value, emu->c_reg);
+		return value;
 	case D_REG_TYPE:
-		return emu->d_reg + val;
+		addl(&value, emu->d_reg);
+		return value;
 	case ERR_REG_TYPE:
-		return emu->err_reg + val;
+		addl(&value, emu->err_reg);
+		return value;
 	case STACK_REG_TYPE:
-		return emu->stack_reg + val;
+		addl(&value, emu->stack_reg);
+		return value;
 	case BASE_REG_TYPE:
-		return emu->base_reg + val;
+		addl(&value, emu->base_reg);
+		return value;
 	default:
-		fprintf(stderr, "[Debug] CPU FAULT: 0x%x on get_value_on_type()!\n",
-		SEGMENTATION_FAULT);
-		emu->err_reg = SEGMENTATION_FAULT;
+		cpu_fault(SEGMENTATION_FAULT, "get_value_on_type", &emu->err_reg,
+				emu->isQuiet);
 		return emu->err_reg;
 	}
 }
@@ -27,13 +27,28 @@
 #ifndef EMULATOR_H_
 #define EMULATOR_H_
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define SEGMENTATION_FAULT 5555
 #define HDD_BIT_OFFSET 10
 
+// Number of longs the push/pop memory needs for a given stack size
+#define EMULATOR_SPECIAL_MEM_SIZE(stackSize) ((stackSize) / 2)
+
 typedef enum {
 	EIGHT_BIT_MAX_MEM = 256, SIXTEEN_BIT_MAX_MEM = 65535
 } MemSizeConstants;
 
+/*
+ * The layout isn't part of the ABI: fields get added between releases, so anything built against
+ * libdirt.so has to be rebuilt with it. Set it up with emulator_init() or emulator_init_mem()
+ */
 typedef struct {
 	// CPU
 	long nop_reg, a_reg, b_reg, c_reg, d_reg, err_reg, stack_reg, base_reg; // general purpose registers
@@ -44,12 +59,23 @@ typedef struct {
 	long *specialMem; // push pop stuff goes here
 	long specialMemCounter;
 	long stackSize;
+	bool ownsMem; // false if the caller handed us the memory (see emulator_init_mem)
 
 	// Program
 	long instructionCounter;
+	long instructionsRetired;
+	bool isLoaded; // the program is already in RAM, so emulator_start() won't read the hdd
+	bool isHalted; // INT_SYS_EXIT_CODE was called or the cpu ran off the end of memory
+	struct timing_model_s *timing; // NULL runs at full speed without the timing model (see timing.h)
+	struct sample_slot_s *sample; // NULL unless a profiler is watching (see profiler.h), don't change it mid-run
 
 	// ROM
 	FILE *hdd; // like the text hard drive with the hex stuff
+	struct stream_s *stream; // NULL unless the code is still being read from the hdd (see stream.h)
+
+	// IO
+	FILE *console; // where INT_STDOUT_CODE writes to (stdout by default, NULL throws it away)
+	bool isQuiet; // turns off the instruction trace and the fault messages
 } emulator_t;
 
 typedef enum {
@@ -94,7 +120,9 @@ typedef enum {
 } InstructionSet;
 
 typedef enum {
-	INT_STDOUT_CODE = 0x01, INT_SYS_EXIT_CODE = 0x02
+	INT_STDOUT_CODE = 0x01,
+	INT_SYS_EXIT_CODE = 0x02,
+	INT_PERF_COUNTERS_CODE = 0x03 // a = cycles, b = instructions retired, c = branch mispredicts, d = cache misses (all counting this intl)
 } InterruptCodes;
 
 typedef enum {
@@ -111,7 +139,32 @@ typedef enum {
 } Types;
 
 int emulator_init(long stackSize, FILE *hdd, emulator_t *emu);
+/*
+ * Same as emulator_init() but without any malloc: stack must hold stackSize longs and specialMem
+ * EMULATOR_SPECIAL_MEM_SIZE(stackSize) longs. emulator_free() won't touch them.
+ */
+int emulator_init_mem(long stackSize, long *stack, long *specialMem,
+		emulator_t *emu);
 void emulator_free(emulator_t *emu);
+/*
+ * Clears the registers and memory so the same emulator can run another program
+ */
+void emulator_reset(emulator_t *emu);
+/*
+ * Loads the program from emu->hdd right away instead of waiting for emulator_start().
+ * Returns -1 if it's cut short or faults while loading, and isLoaded stays false
+ */
+int emulator_load_hdd(emulator_t *emu);
+/*
+ * Loads a program from an hdd image that is already in memory (same text format as the hdd file).
+ * Same rules as emulator_load_hdd(), and a program that doesn't fit fails before anything is loaded
+ */
+int emulator_load_image(const char *image, size_t imageSize, emulator_t *emu);
+/*
+ * Loads numLines already decoded instructions (4 longs each: opcode, register, type, value).
+ * Same rules as emulator_load_image()
+ */
+int emulator_load_words(const long *words, long numLines, emulator_t *emu);
 
 int emulator_create_hdd(long hddSize, FILE *hdd);
 int emulator_flash_pgrm_to_hdd(long location, FILE *pgrm, FILE *hdd);
@@ -119,5 +172,15 @@ int emulator_flash_pgrm_to_hdd(long location, FILE *pgrm, FILE *hdd);
  * Returns a error code of -1 or less if it encounters a error or returns 0 if everything went fine
  */
 int emulator_start(emulator_t *emu);
+/*
+ * Keeps running the loaded program from where it stopped for at most maxInstructions instructions
+ * (no limit if it is negative). Returns 1 if the program can still go on, 0 if it exited,
+ * or -1 or less on error
+ */
+int emulator_run(emulator_t *emu, long maxInstructions);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* EMULATOR_H_ */
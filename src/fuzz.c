@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * fuzz.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+/*
+ * Differential fuzzer: every engine runs the same random program and has to end up
+ * in exactly the same state as the reference switch interpreter after each block.
+ *
+ * libFuzzer: clang -fsanitize=fuzzer,address,undefined -DDIRT_LIBFUZZER -pthread src/fuzz.c src/emulator.c src/stream.c src/timing.c
+ * AFL:       afl-cc -pthread -o dirt-fuzz src/fuzz.c src/emulator.c src/stream.c src/timing.c && afl-fuzz -i in -o out -- ./dirt-fuzz @@
+ * In-process: ./dirt-fuzz -n [number of programs] -s [seed]
+ */
+
+#define _POSIX_C_SOURCE 200809L // fmemopen()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "emulator.h"
+#include "timing.h"
+#include "stream.h"
+
+#define FUZZ_MEM_SIZE EIGHT_BIT_MAX_MEM
+#define FUZZ_MAX_LINES 48 // leaves some memory for stmovl
+#define FUZZ_BLOCK_SIZE 64 // instructions between state comparisons
+#define FUZZ_BUDGET 4096 // instructions per program (most of them never exit)
+#define FUZZ_UNCOMPARABLE 2 // returned by an engine that can't be compared to the reference anymore
+#define FUZZ_PAGE_SHIFT 3 // 2 instructions per page, so even short programs are streamed in many pages
+
+typedef struct {
+	const char *name;
+	int (*run)(emulator_t *emu, long maxInstructions);
+	bool isTimed; // the timing model must never change what the program does
+	bool isStreamed; // the program goes through an hdd file and stream_open()
+
+	emulator_t emu;
+	timing_model_t timing;
+	long stack[FUZZ_MEM_SIZE];
+	long specialMem[EMULATOR_SPECIAL_MEM_SIZE(FUZZ_MEM_SIZE)];
+} engine_t;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void setup_engines(void);
+static int run_stepped(emulator_t *emu, long maxInstructions);
+static int run_until_perf_counters(emulator_t *emu, long maxInstructions);
+static long decode_program(const uint8_t *data, size_t size, long *words);
+static void fuzz_program(const long *words, long numLines);
+static int load_streamed(const long *words, long numLines, emulator_t *emu);
+static int put_word(unsigned long word, char *out);
+static bool is_same_state(const emulator_t *ref, const emulator_t *emu);
+static bool is_same_memory(const emulator_t *ref, const emulator_t *emu);
+static void report_mismatch(const long *words, long numLines, engine_t *engine,
+		long executed);
+static void print_state(const emulator_t *emu);
+
+// The first engine is the reference, keep it the plain switch interpreter
+static engine_t engines[] = {
+		{ .name = "switch", .run = emulator_run },
+		{ .name = "switch-stepped", .run = run_stepped },
+		{ .name = "switch-timed", .run = emulator_run, .isTimed = true },
+		{ .name = "switch-streamed", .run = emulator_run, .isStreamed = true } };
+#define NUM_ENGINES ((int) (sizeof(engines) / sizeof(engines[0])))
+
+static const long opcodes[] = { NOP_INSTR, MOVL_INSTR, STMOVL_INSTR,
+		ADDL_INSTR, SUBL_INSTR, IMUL_INSTR, IDIVL_INSTR, ANDL_INSTR, ORL_INSTR,
+		XORL_INSTR, SHRW_INSTR, SHLW_INSTR, CMPL_INSTR, JE_INSTR, JL_INSTR,
+		JG_INSTR, JLE_INSTR, JGE_INSTR, JMP_INSTR, PUSHL_INSTR, POPL_INSTR,
+		INTL_INSTR };
+#define NUM_OPCODES ((int) (sizeof(opcodes) / sizeof(opcodes[0])))
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	static bool isSetUp = false;
+	if (!isSetUp) {
+		setup_engines();
+		isSetUp = true;
+	}
+
+	long words[FUZZ_MAX_LINES * 4];
+	long numLines = decode_program(data, size, words);
+	if (numLines > 0) {
+		fuzz_program(words, numLines);
+	}
+	return 0;
+}
+
+static void setup_engines(void) {
+	for (int i = 0; i < NUM_ENGINES; i++) {
+		emulator_init_mem(FUZZ_MEM_SIZE, engines[i].stack,
+				engines[i].specialMem, &engines[i].emu);
+		engines[i].emu.console = NULL;
+		engines[i].emu.isQuiet = true;
+		if (engines[i].isTimed) {
+			timing_init(&engines[i].timing);
+			engines[i].emu.timing = &engines[i].timing;
+		}
+	}
+}
+
+// Same interpreter, but one instruction at a time (checks that stopping and resuming is invisible)
+static int run_stepped(emulator_t *emu, long maxInstructions) {
+	int status = 1;
+	for (long i = 0; i < maxInstructions && status == 1; i++) {
+		status = emulator_run(emu, 1);
+	}
+	return status;
+}
+
+/*
+ * INT_PERF_COUNTERS_CODE hands the model's counters to the guest, so from there on the timed
+ * engine is allowed to go its own way. decode_program() never emits it, but stmovl can write it
+ * (or an intl that takes its code from a register) into the program. When the timed engine
+ * doesn't match, it's run again with this to find out if that's why
+ */
+static int run_until_perf_counters(emulator_t *emu, long maxInstructions) {
+	int status = 1;
+	for (long i = 0; i < maxInstructions && status == 1; i++) {
+		const long *next = emu->stack + emu->instructionCounter;
+		if (emu->instructionCounter >= 0
+				&& emu->instructionCounter + 3 < emu->stackSize
+				&& next[0] == INTL_INSTR
+				&& (next[2] != INTEGER_TYPE || next[3] == INT_PERF_COUNTERS_CODE)) {
+			return FUZZ_UNCOMPARABLE;
+		}
+		status = emulator_run(emu, 1);
+	}
+	return status;
+}
+
+/*
+ * Every 4 input bytes become one valid instruction, so the fuzzer's mutations stay meaningful:
+ * [opcode] [register] [type] [value]
+ */
+static long decode_program(const uint8_t *data, size_t size, long *words) {
+	long numLines = size / 4;
+	if (numLines > FUZZ_MAX_LINES) {
+		numLines = FUZZ_MAX_LINES;
+	}
+
+	for (long i = 0; i < numLines; i++) {
+		const uint8_t *bytes = data + i * 4;
+		long opcode = opcodes[bytes[0] % NUM_OPCODES];
+		long reg = bytes[1] % (BASE_REG_HEX + 1);
+		long type = bytes[2] % (BASE_REG_TYPE + 1);
+		long val = (int8_t) bytes[3];
+
+		switch (opcode) {
+		case JE_INSTR:
+		case JL_INSTR:
+		case JG_INSTR:
+		case JLE_INSTR:
+		case JGE_INSTR:
+		case JMP_INSTR:
+			type = INTEGER_TYPE;
+			val = 1 + bytes[3] % numLines;
+			break;
+		case INTL_INSTR:
+			type = INTEGER_TYPE;
+			// 0 is a bad interrupt on purpose, INT_PERF_COUNTERS_CODE is left out since
+			// the counters are supposed to differ between engines
+			val = bytes[3] % (INT_SYS_EXIT_CODE + 1);
+			break;
+		}
+
+		words[i * 4] = opcode;
+		words[i * 4 + 1] = reg;
+		words[i * 4 + 2] = type;
+		words[i * 4 + 3] = val;
+	}
+	return numLines;
+}
+
+static void fuzz_program(const long *words, long numLines) {
+	bool isComparable[NUM_ENGINES];
+	for (int i = 0; i < NUM_ENGINES; i++) {
+		emulator_reset(&engines[i].emu);
+		if (engines[i].isStreamed) {
+			if (load_streamed(words, numLines, &engines[i].emu) < 0) {
+				report_mismatch(words, numLines, &engines[i], 0);
+			}
+		} else {
+			emulator_load_words(words, numLines, &engines[i].emu);
+		}
+		isComparable[i] = true;
+	}
+
+	for (long executed = 0; executed < FUZZ_BUDGET; executed +=
+	FUZZ_BLOCK_SIZE) {
+		int refStatus = engines[0].run(&engines[0].emu, FUZZ_BLOCK_SIZE);
+		for (int i = 1; i < NUM_ENGINES; i++) {
+			if (!isComparable[i]) {
+				continue;
+			}
+			int status = engines[i].run(&engines[i].emu, FUZZ_BLOCK_SIZE);
+			bool isSame = status == refStatus
+					&& is_same_state(&engines[0].emu, &engines[i].emu);
+			if (!isSame && engines[i].isTimed) {
+				// Rare, so run it again from the start instead of keeping a copy of every block
+				emulator_reset(&engines[i].emu);
+				emulator_load_words(words, numLines, &engines[i].emu);
+				status = run_until_perf_counters(&engines[i].emu,
+						executed + FUZZ_BLOCK_SIZE);
+				isSame = status == refStatus
+						&& is_same_state(&engines[0].emu, &engines[i].emu);
+			}
+			if (status == FUZZ_UNCOMPARABLE) {
+				isComparable[i] = false;
+			} else if (!isSame) {
+				report_mismatch(words, numLines, &engines[i],
+						executed + FUZZ_BLOCK_SIZE);
+			}
+		}
+		if (refStatus != 1) {
+			break;
+		}
+	}
+}
+
+// Same as sprintf(out, "%08lx ", word)
+static int put_word(unsigned long word, char *out) {
+	static const char digits[] = "0123456789abcdef";
+	int numDigits = word > 0xffffffffUL ? 16 : 8;
+	for (int i = numDigits - 1; i >= 0; i--, word >>= 4) {
+		out[i] = digits[word & 0xf];
+	}
+	out[numDigits] = ' ';
+	return numDigits + 1;
+}
+
+/*
+ * Writes the program like assemble() does (negative values take 16 digits) into an in-memory hdd,
+ * a file would make this engine cost more than all the others. Every other program leaves out
+ * the last instruction's offset, so stream_open() has to index its way there
+ */
+static int load_streamed(const long *words, long numLines, emulator_t *emu) {
+	static char image[36 + FUZZ_MAX_LINES * 4 * 17];
+	if (emu->hdd != NULL) {
+		fclose(emu->hdd);
+	}
+
+	int size = sprintf(image, "%08x %08lx %08x %08x ", 0x1, numLines, 0x0, 0x0);
+	for (long i = 0; i < numLines * 4; i++) {
+		if (i == (numLines - 1) * 4 && numLines % 2 == 0) {
+			char offset[9];
+			sprintf(offset, "%08x", size);
+			memcpy(image + 18, offset, 8); // the header's first operand
+		}
+		size += put_word((unsigned long) words[i], image + size);
+	}
+
+	emu->hdd = fmemopen(image, size, "r");
+	if (emu->hdd == NULL) {
+		return -1;
+	}
+	return stream_open_paged(emu, false, FUZZ_PAGE_SHIFT);
+}
+
+static bool is_same_state(const emulator_t *ref, const emulator_t *emu) {
+	return ref->nop_reg == emu->nop_reg && ref->a_reg == emu->a_reg
+			&& ref->b_reg == emu->b_reg && ref->c_reg == emu->c_reg
+			&& ref->d_reg == emu->d_reg && ref->err_reg == emu->err_reg
+			&& ref->stack_reg == emu->stack_reg
+			&& ref->base_reg == emu->base_reg
+			&& ref->x_special_reg == emu->x_special_reg
+			&& ref->specialMemCounter == emu->specialMemCounter
+			&& ref->instructionCounter == emu->instructionCounter
+			&& ref->instructionsRetired == emu->instructionsRetired
+			&& ref->isHalted == emu->isHalted && is_same_memory(ref, emu)
+			&& memcmp(ref->specialMem, emu->specialMem,
+					EMULATOR_SPECIAL_MEM_SIZE(ref->stackSize) * sizeof(long))
+					== 0;
+}
+
+// Code pages the streamed engine hasn't read yet are still zeros, those don't count
+static bool is_same_memory(const emulator_t *ref, const emulator_t *emu) {
+	const stream_t *stream = emu->stream;
+	if (stream == NULL) {
+		return memcmp(ref->stack, emu->stack, ref->stackSize * sizeof(long)) == 0;
+	}
+	long pageWords = 1L << stream->pageShift;
+	for (long i = 0; i < ref->stackSize; i += pageWords) {
+		long page = i >> stream->pageShift;
+		long numWords = ref->stackSize - i < pageWords ?
+				ref->stackSize - i : pageWords;
+		if ((page >= stream->numPages || atomic_load(&stream->isResident[page]))
+				&& memcmp(ref->stack + i, emu->stack + i,
+						numWords * sizeof(long)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void report_mismatch(const long *words, long numLines, engine_t *engine,
+		long executed) {
+	fprintf(stderr, "[fuzz] %s does not match %s after %ld instructions\n",
+			engine->name, engines[0].name, executed);
+	fprintf(stderr, "Program:\n");
+	for (long i = 0; i < numLines; i++) {
+		fprintf(stderr, "%08lx %08lx %08lx %08lx\n", words[i * 4],
+				words[i * 4 + 1], words[i * 4 + 2], words[i * 4 + 3]);
+	}
+	fprintf(stderr, "%s:\n", engines[0].name);
+	print_state(&engines[0].emu);
+	fprintf(stderr, "%s:\n", engine->name);
+	print_state(&engine->emu);
+	abort(); // so libFuzzer / AFL keep the input
+}
+
+static void print_state(const emulator_t *emu) {
+	fprintf(stderr, "A, B, C, D: %ld %ld %ld %ld\n", emu->a_reg, emu->b_reg,
+			emu->c_reg, emu->d_reg);
+	fprintf(stderr, "Nop, Error, Stack, Base, X Special Reg: %ld %ld %ld %ld %ld\n",
+			emu->nop_reg, emu->err_reg, emu->stack_reg, emu->base_reg,
+			emu->x_special_reg);
+	fprintf(stderr, "Instruction Counter: %ld, Retired: %ld, Halted: %d\n",
+			emu->instructionCounter, emu->instructionsRetired, emu->isHalted);
+	fprintf(stderr, "emu->specialMemCounter: %ld\n", emu->specialMemCounter);
+}
+
+#ifndef DIRT_LIBFUZZER
+static uint64_t xorshift64(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+// Usage: dirt-fuzz [input file] (AFL) or dirt-fuzz -n [number of programs] -s [seed]
+int main(int argc, char **argv) {
+	long numPrograms = 0;
+	uint64_t seed = (uint64_t) time(NULL);
+	char *inputPath = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			numPrograms = strtol(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else {
+			inputPath = argv[i];
+		}
+	}
+
+	uint8_t data[FUZZ_MAX_LINES * 4];
+	if (numPrograms <= 0) {
+		FILE *input = inputPath == NULL ? stdin : fopen(inputPath, "rb");
+		if (input == NULL) {
+			return -1;
+		}
+		size_t size = fread(data, 1, sizeof(data), input);
+		if (input != stdin) {
+			fclose(input);
+		}
+		return LLVMFuzzerTestOneInput(data, size);
+	}
+
+	// In-process mode, nothing gets allocated per program
+	printf("[fuzz] seed: %llu\n", (unsigned long long) seed);
+	uint64_t state = seed == 0 ? 1 : seed;
+	clock_t start = clock();
+	for (long n = 0; n < numPrograms; n++) {
+		size_t size = 4 + xorshift64(&state) % (sizeof(data) - 3);
+		for (size_t i = 0; i < size; i++) {
+			data[i] = (uint8_t) xorshift64(&state);
+		}
+		LLVMFuzzerTestOneInput(data, size);
+	}
+	double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("[fuzz] %ld programs, %d engines, %f s (%.0f programs/min)\n",
+			numPrograms, NUM_ENGINES, seconds,
+			seconds > 0 ? numPrograms / seconds * 60 : 0);
+	return 0;
+}
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * imgcache.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "emulator.h"
+#include "compress.h"
+#include "imgcache.h"
+
+#define IMGCACHE_MAGIC "DIRTIMG2"
+#define IMGCACHE_VERSION 2 // bump this whenever assemble() output changes
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static void entry_path(const char *dir, unsigned long long key, char *path,
+		size_t pathSize);
+static unsigned long long hash_bytes(unsigned long long hash,
+		const void *bytes, size_t size);
+
+static atomic_uint numStores; // with the pid, gives every imgcache_store() its own temporary file
+
+int imgcache_key(FILE *source, long stackSize, unsigned long long *key) {
+	long options[2] = { IMGCACHE_VERSION, stackSize };
+	unsigned long long hash = hash_bytes(FNV_OFFSET, options, sizeof(options));
+
+	char buffer[1 << 16];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+		hash = hash_bytes(hash, buffer, size);
+	}
+	if (ferror(source)) {
+		return -1;
+	}
+	rewind(source);
+	*key = hash;
+	return 0;
+}
+
+// Format: magic, key, number of lines, hash of the words, compressed size, compressed words
+int imgcache_load(const char *dir, unsigned long long key, emulator_t *emu) {
+	char path[1024];
+	entry_path(dir, key, path, sizeof(path));
+	FILE *entry = fopen(path, "rb");
+	if (entry == NULL) {
+		return 1;
+	}
+
+	char magic[8];
+	unsigned long long entryKey, wordsHash;
+	long numLines;
+	size_t size;
+	if (fread(magic, 1, 8, entry) != 8 || memcmp(magic, IMGCACHE_MAGIC, 8) != 0
+			|| fread(&entryKey, sizeof(entryKey), 1, entry) != 1
+			|| fread(&numLines, sizeof(long), 1, entry) != 1
+			|| fread(&wordsHash, sizeof(wordsHash), 1, entry) != 1
+			|| fread(&size, sizeof(size_t), 1, entry) != 1 || entryKey != key
+			|| numLines < 0 || numLines * 4 > emu->stackSize
+			|| size > COMPRESS_BOUND(numLines * 4)) {
+		fclose(entry);
+		return 1; // a broken entry is just a miss, it gets overwritten
+	}
+
+	unsigned char *data = malloc(size > 0 ? size : 1);
+	if (data == NULL) {
+		fclose(entry);
+		return -1;
+	}
+	// The decompressor only checks the framing, so a damaged entry can still decode to other words
+	if (fread(data, 1, size, entry) != size
+			|| decompress_words(data, size, emu->stack, emu->stackSize)
+					!= numLines * 4
+			|| hash_bytes(FNV_OFFSET, emu->stack, numLines * 4 * sizeof(long))
+					!= wordsHash) {
+		free(data);
+		fclose(entry);
+		return 1;
+	}
+	free(data);
+	fclose(entry);
+
+	// The words are already in place, this only sets the registers like the normal loader
+	return emulator_load_words(emu->stack, numLines, emu) < 0 ? -1 : 0;
+}
+
+int imgcache_store(const char *dir, unsigned long long key,
+		const emulator_t *emu) {
+	if (!emu->isLoaded || emu->err_reg != 0) {
+		return -1; // only cache programs that loaded cleanly
+	}
+	long numLines = emu->stack_reg / 4;
+	unsigned char *data = malloc(COMPRESS_BOUND(numLines * 4) + 1);
+	if (data == NULL) {
+		return -1;
+	}
+	size_t size = compress_words(emu->stack, numLines * 4, data);
+	unsigned long long wordsHash = hash_bytes(FNV_OFFSET, emu->stack,
+			numLines * 4 * sizeof(long));
+
+	// Write a temporary file and rename it so nobody reads half an entry. Two processes (or
+	// threads) storing the same key each get their own, the last rename wins
+	char path[1024], tmpPath[1064];
+	entry_path(dir, key, path, sizeof(path));
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%ld.%u.tmp", path, (long) getpid(),
+			atomic_fetch_add(&numStores, 1));
+	FILE *entry = fopen(tmpPath, "wb");
+	if (entry == NULL) {
+		free(data);
+		return -1;
+	}
+	int result = 0;
+	if (fwrite(IMGCACHE_MAGIC, 1, 8, entry) != 8
+			|| fwrite(&key, sizeof(key), 1, entry) != 1
+			|| fwrite(&numLines, sizeof(long), 1, entry) != 1
+			|| fwrite(&wordsHash, sizeof(wordsHash), 1, entry) != 1
+			|| fwrite(&size, sizeof(size_t), 1, entry) != 1
+			|| fwrite(data, 1, size, entry) != size) {
+		result = -1;
+	}
+	free(data);
+	if (fclose(entry) != 0) {
+		result = -1;
+	}
+
+#ifdef _WIN32
+	remove(path); // rename() doesn't replace files on Windows
+#endif
+	if (result < 0 || rename(tmpPath, path) != 0) {
+		remove(tmpPath);
+		return -1;
+	}
+	return 0;
+}
+
+static void entry_path(const char *dir, unsigned long long key, char *path,
+		size_t pathSize) {
+	snprintf(path, pathSize, "%s/%016llx.img", dir, key);
+}
+
+// FNV-1a
+static unsigned long long hash_bytes(unsigned long long hash,
+		const void *bytes, size_t size) {
+	const unsigned char *data = bytes;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * imgcache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef IMGCACHE_H_
+#define IMGCACHE_H_
+
+#include <stdio.h>
+
+#include "emulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-disk cache of assembled programs, named after a hash of the .dasm source and the memory
+ * size. Entries hold the decoded instruction words (compressed with compress.h), so a hit skips
+ * assembling and parsing the hdd and decompresses straight into emulator memory.
+ */
+
+/*
+ * Hashes everything left in source (and rewinds it afterwards)
+ */
+int imgcache_key(FILE *source, long stackSize, unsigned long long *key);
+/*
+ * Returns 0 and loads the program into emu if the cache has it, 1 if it doesn't and -1 on error
+ */
+int imgcache_load(const char *dir, unsigned long long key, emulator_t *emu);
+/*
+ * Saves the program that was just loaded into emu (call it before the program runs)
+ */
+int imgcache_store(const char *dir, unsigned long long key,
+		const emulator_t *emu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMGCACHE_H_ */
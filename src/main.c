@@ -27,55 +27,170 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include "emulator.h"
 #include "assembler.h"
+#include "timing.h"
+#include "imgcache.h"
 
+// Smaller sources assemble faster than the threads take to start
+#define PARALLEL_ASSEMBLY_MIN_SIZE (1L << 20)
+
+static int assembleToHdd(FILE *input, char *hddPath, int numThreads);
+static long fileSize(FILE *file);
+static long memorySize(FILE *input);
 static void createHdd(long hddSize, char *destFile);
+static void createDir(char *dir);
 
+// Usage: dirt [--fast] [program.dasm] [program.hdd] [cache directory] [assembler threads]
+// --fast runs without the timing model, so there are no guest cycles to report
 int main(int argc, char **argv) {
+	bool isFast = argc > 1 && strcmp(argv[1], "--fast") == 0;
+	if (isFast) {
+		argc--;
+		argv++;
+	}
+	char *dasmPath = argc > 1 ? argv[1] : "src/everything.dasm";
+	char *hddPath = argc > 2 ? argv[2] : "src/everything.hdd";
+	char *cacheDir = argc > 3 ? argv[3] : ".dirtcache";
+	int numThreads = argc > 4 ? atoi(argv[4]) : 1;
+
 	clock_t start, end;
 	start = clock();
 
-	// Create hdd for the first time...
-	createHdd(EIGHT_BIT_MAX_MEM, "src/everything.hdd");
+	FILE *input;
+	input = fopen(dasmPath, "r");
+	if (input == NULL) {
+		return -1;
+	}
+	long memSize = memorySize(input);
+	unsigned long long key;
+	if (memSize < 0 || imgcache_key(input, memSize, &key) < 0) {
+		fclose(input);
+		return -1;
+	}
 
-	// Start the assembler
-	FILE *input, *hddOutput;
-	input = fopen("src/everything.dasm", "r");
-	hddOutput = fopen("src/everything.hdd", "r+");
-	if (input == NULL || hddOutput == NULL) {
+	emulator_t emu = { 0 };
+	timing_model_t timing;
+	if (emulator_init(memSize, NULL, &emu) < 0) {
+		fclose(input);
 		return -1;
 	}
-	fseek(hddOutput, 0, SEEK_SET); // the program is accessed without any disk formatting, etc.
-	assemble(input, hddOutput);
+	if (!isFast) {
+		timing_init(&timing);
+		emu.timing = &timing;
+	}
 
-	fclose(input);
-	fclose(hddOutput);
+	// Only assemble if this exact source hasn't been seen before
+	FILE *hdd = NULL;
+	if (imgcache_load(cacheDir, key, &emu) != 0) {
+		emulator_reset(&emu); // in case the cache entry was half loaded
+		if (assembleToHdd(input, hddPath, numThreads) < 0
+				|| (hdd = fopen(hddPath, "r")) == NULL) {
+			fclose(input);
+			emulator_free(&emu);
+			return -1;
+		}
+		emu.hdd = hdd;
+		if (emulator_load_hdd(&emu) != 0) {
+			fprintf(stderr, "[main] Could not load %s\n", hddPath);
+			fclose(input);
+			emulator_free(&emu);
+			fclose(hdd);
+			return -1;
+		}
 
-	// Start the emulator
-	FILE *hdd;
-	hdd = fopen("src/everything.hdd", "r");
-	if (hdd == NULL) {
-		return -1;
+		createDir(cacheDir);
+		if (imgcache_store(cacheDir, key, &emu) < 0) {
+			fprintf(stderr, "[main] Could not cache the program in %s\n",
+					cacheDir);
+		}
 	}
+	fclose(input);
 
-	emulator_t emu = { 0 };
-	emulator_init(EIGHT_BIT_MAX_MEM, hdd, &emu);
+	// Start the emulator
 	emulator_start(&emu);
-	emulator_free(&emu);
-
-	fclose(hdd);
 
 	end = clock();
 	printf("[main] Benchmarks: %f\n", (double) (end - start) / CLOCKS_PER_SEC);
+	if (isFast) {
+		printf("[main] Guest: %ld instructions\n", emu.instructionsRetired);
+	} else {
+		printf("[main] Guest: %ld cycles, %ld instructions, %ld branch mispredicts, %ld cache misses\n",
+				timing.cycles, emu.instructionsRetired,
+				timing.branchMispredicts, timing.cacheMisses);
+	}
+
+	emulator_free(&emu);
+	if (hdd != NULL) {
+		fclose(hdd);
+	}
 	return 0;
 }
 
+static int assembleToHdd(FILE *input, char *hddPath, int numThreads) {
+	// Create hdd for the first time...
+	createHdd(EIGHT_BIT_MAX_MEM, hddPath);
+
+	// Start the assembler
+	FILE *hddOutput;
+	hddOutput = fopen(hddPath, "r+");
+	if (hddOutput == NULL) {
+		return -1;
+	}
+	fseek(hddOutput, 0, SEEK_SET); // the program is accessed without any disk formatting, etc.
+	int result;
+	if (numThreads > 1 && fileSize(input) >= PARALLEL_ASSEMBLY_MIN_SIZE) {
+		result = assemble_parallel(input, hddOutput, numThreads);
+	} else {
+		result = assemble(input, hddOutput);
+	}
+	fclose(hddOutput);
+	return result;
+}
+
+// Leaves the file at the start
+static long fileSize(FILE *file) {
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	rewind(file);
+	return size;
+}
+
+// Sized from the .exe line that starts the source: at least the 8 bit machine, and always half
+// of it free past the code. Leaves the file at the start
+static long memorySize(FILE *input) {
+	char preprocessor[50];
+	long numLines;
+	int count = fscanf(input, "%49s %ld", preprocessor, &numLines);
+	rewind(input);
+	if (count < 2 || numLines < 0
+			|| numLines > (LONG_MAX - EIGHT_BIT_MAX_MEM / 2) / 4) {
+		return -1;
+	}
+	long size = numLines * 4 + EIGHT_BIT_MAX_MEM / 2;
+	return size > EIGHT_BIT_MAX_MEM ? size : EIGHT_BIT_MAX_MEM;
+}
+
 static void createHdd(long hddSize, char *destFile) {
 	FILE *hdd;
 	hdd = fopen(destFile, "w");
 	emulator_create_hdd(hddSize, hdd);
 	fclose(hdd);
 }
+
+// Fails quietly if it's already there
+static void createDir(char *dir) {
+#ifdef _WIN32
+	_mkdir(dir);
+#else
+	mkdir(dir, 0755);
+#endif
+}
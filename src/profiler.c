@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * profiler.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "emulator.h"
+#include "profiler.h"
+
+#define EXPORT_INTERVAL_NANOS 1000000000L
+
+static void* watch(void *arg);
+static void take_sample(profiler_t *profiler);
+static int write_metrics(const profiler_t *profiler);
+static long now_nanos(void);
+
+int profiler_start(profiler_t *profiler, emulator_t *emu,
+		const char *metricsPath, long sampleMicros) {
+	memset(profiler, 0, sizeof(profiler_t));
+	profiler->numLines = emu->stackSize / 4;
+	profiler->histogram = calloc(profiler->numLines + 1, sizeof(long));
+	profiler->opcodes = calloc(profiler->numLines + 1, 1);
+	if (profiler->histogram == NULL || profiler->opcodes == NULL) {
+		free(profiler->histogram);
+		free(profiler->opcodes);
+		return -1;
+	}
+	profiler->metricsPath = metricsPath;
+	profiler->sampleMicros = sampleMicros > 0 ? sampleMicros : 1000;
+	atomic_init(&profiler->slot.location, 0);
+	atomic_init(&profiler->slot.instructionsRetired, 0);
+	profiler_publish(&profiler->slot, emu->instructionCounter, NOP_INSTR,
+			emu->instructionsRetired);
+	profiler->instructionsRetired = emu->instructionsRetired;
+	atomic_init(&profiler->isStopping, false);
+
+	emu->sample = &profiler->slot;
+	if (pthread_create(&profiler->watcher, NULL, watch, profiler) != 0) {
+		emu->sample = NULL;
+		free(profiler->histogram);
+		free(profiler->opcodes);
+		return -1;
+	}
+	return 0;
+}
+
+void profiler_stop(profiler_t *profiler, emulator_t *emu) {
+	atomic_store(&profiler->isStopping, true);
+	pthread_join(profiler->watcher, NULL);
+	emu->sample = NULL;
+
+	take_sample(profiler);
+	if (profiler->metricsPath != NULL) {
+		write_metrics(profiler);
+	}
+}
+
+void profiler_free(profiler_t *profiler) {
+	free(profiler->histogram);
+	free(profiler->opcodes);
+	profiler->histogram = NULL;
+	profiler->opcodes = NULL;
+}
+
+int profiler_export(const profiler_t *profiler, FILE *out) {
+	fprintf(out, "# HELP dirt_instructions_retired_total Instructions the guest has retired.\n");
+	fprintf(out, "# TYPE dirt_instructions_retired_total counter\n");
+	fprintf(out, "dirt_instructions_retired_total %ld\n",
+			profiler->instructionsRetired);
+	fprintf(out, "# HELP dirt_instructions_per_second Guest instructions per second over the last export interval.\n");
+	fprintf(out, "# TYPE dirt_instructions_per_second gauge\n");
+	fprintf(out, "dirt_instructions_per_second %.0f\n",
+			profiler->instructionsPerSecond);
+	fprintf(out, "# HELP dirt_samples_total Samples taken by the profiler.\n");
+	fprintf(out, "# TYPE dirt_samples_total counter\n");
+	fprintf(out, "dirt_samples_total %ld\n", profiler->numSamples);
+	fprintf(out, "# HELP dirt_line_samples_total Samples that ended a basic block on this line (numbered from 1 like jump targets).\n");
+	fprintf(out, "# TYPE dirt_line_samples_total counter\n");
+	for (long i = 0; i <= profiler->numLines; i++) {
+		if (profiler->histogram[i] > 0) {
+			fprintf(out, "dirt_line_samples_total{line=\"%ld\",opcode=\"0x%x\"} %ld\n",
+					i + 1, profiler->opcodes[i], profiler->histogram[i]);
+		}
+	}
+	return ferror(out) ? -1 : 0;
+}
+
+static void* watch(void *arg) {
+	profiler_t *profiler = arg;
+	struct timespec interval = { profiler->sampleMicros / 1000000,
+			(profiler->sampleMicros % 1000000) * 1000 };
+
+	long lastExport = now_nanos();
+	long lastRetired = atomic_load_explicit(
+			&profiler->slot.instructionsRetired, memory_order_relaxed);
+	while (!atomic_load(&profiler->isStopping)) {
+		nanosleep(&interval, NULL);
+		take_sample(profiler);
+
+		long now = now_nanos();
+		if (now - lastExport >= EXPORT_INTERVAL_NANOS) {
+			long retired = profiler->instructionsRetired;
+			if (retired < lastRetired) {
+				lastRetired = 0; // the emulator was reset
+			}
+			profiler->instructionsPerSecond = (double) (retired - lastRetired)
+					* 1e9 / (now - lastExport);
+			lastRetired = retired;
+			lastExport = now;
+			if (profiler->metricsPath != NULL) {
+				write_metrics(profiler);
+			}
+		}
+	}
+	return NULL;
+}
+
+static void take_sample(profiler_t *profiler) {
+	long location = atomic_load_explicit(&profiler->slot.location,
+			memory_order_relaxed);
+	long retired = atomic_load_explicit(&profiler->slot.instructionsRetired,
+			memory_order_relaxed);
+	if (retired == profiler->instructionsRetired) {
+		return; // nothing ran since the last sample (emulator_run() returned), so the guest isn't there
+	}
+	profiler->instructionsRetired = retired;
+
+	long line = (long) ((unsigned long) location >> 8) / 4;
+	if (line >= 0 && line <= profiler->numLines) {
+		profiler->histogram[line]++;
+		profiler->opcodes[line] = (unsigned char) (location & 0xff);
+	}
+	profiler->numSamples++;
+}
+
+// Write a temporary file and rename it, so scrapers never see half of it
+static int write_metrics(const profiler_t *profiler) {
+	char tmpPath[1024];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", profiler->metricsPath);
+	FILE *out = fopen(tmpPath, "w");
+	if (out == NULL) {
+		return -1;
+	}
+	int result = profiler_export(profiler, out);
+	if (fclose(out) != 0 || result < 0
+			|| rename(tmpPath, profiler->metricsPath) != 0) {
+		remove(tmpPath);
+		return -1;
+	}
+	return 0;
+}
+
+static long now_nanos(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
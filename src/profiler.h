@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * profiler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "emulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Where the run loop publishes its position. It is only written at the end of a basic block
+ * (any jump, taken or not, an interrupt or the end of emulator_run()) and only read by the
+ * profiler's watcher thread. The two fields are separate relaxed stores, so a sample can pair
+ * one block's location with the retired count of the block next to it; that is one block of
+ * error in the instructions per second, not worth a lock in the run loop
+ */
+typedef struct sample_slot_s {
+	atomic_long location; // instructionCounter << 8 | opcode
+	atomic_long instructionsRetired;
+} sample_slot_t;
+
+/*
+ * Sampling profiler for long running guests: a watcher thread reads the sample slot every
+ * sampleMicros microseconds, keeps a histogram of where the guest was and rewrites
+ * metricsPath (Prometheus text format) about once a second
+ */
+typedef struct {
+	sample_slot_t slot;
+
+	long numLines;
+	long *histogram; // samples per instruction
+	unsigned char *opcodes; // opcode seen at each instruction
+	long numSamples;
+	long instructionsRetired;
+	double instructionsPerSecond;
+
+	const char *metricsPath;
+	long sampleMicros;
+	pthread_t watcher;
+	atomic_bool isStopping;
+} profiler_t;
+
+static inline void profiler_publish(sample_slot_t *slot, long instructionCounter,
+		long opcode, long instructionsRetired) {
+	atomic_store_explicit(&slot->location,
+			(long) ((unsigned long) instructionCounter << 8) | (opcode & 0xff),
+			memory_order_relaxed);
+	atomic_store_explicit(&slot->instructionsRetired, instructionsRetired,
+			memory_order_relaxed);
+}
+
+/*
+ * Hooks the profiler up to emu and starts the watcher thread. metricsPath can be NULL.
+ * emu->sample is a plain pointer, so this and profiler_stop() may only be called while
+ * emulator_run() isn't running on emu
+ */
+int profiler_start(profiler_t *profiler, emulator_t *emu,
+		const char *metricsPath, long sampleMicros);
+/*
+ * Stops the watcher, writes the metrics one last time and unhooks emu
+ */
+void profiler_stop(profiler_t *profiler, emulator_t *emu);
+void profiler_free(profiler_t *profiler);
+/*
+ * Writes the metrics in Prometheus text format (only safe from the watcher or after profiler_stop)
+ */
+int profiler_export(const profiler_t *profiler, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * replay.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "compress.h"
+#include "replay.h"
+#include "stream.h"
+#include "timing.h"
+
+#define REPLAY_MAGIC "DIRTREC3"
+#define REPLAY_NUM_REGS 14
+// Costs, counters, cache tags and branch counters, all zero without a timing model
+#define REPLAY_TIMING_WORDS (TIMING_NUM_OPCODES + 5 + TIMING_CACHE_LINES + TIMING_PREDICTOR_SIZE)
+
+static long snapshot_size(long stackSize);
+static void snapshot(const emulator_t *emu, long *words);
+static void restore(const long *words, emulator_t *emu);
+static void snapshot_timing(const timing_model_t *model, long *words);
+static void restore_timing(const long *words, timing_model_t *model);
+static int add_checkpoint(recording_t *rec, const emulator_t *emu,
+		long *words, unsigned char *buffer);
+
+/*
+ * Nothing in the instruction set reads outside input yet, so the program and the first
+ * checkpoint decide everything that happens after them; only checkpoints are stored.
+ * The cost is one snapshot per checkpointInterval instructions, the run loop isn't touched.
+ */
+int replay_record(emulator_t *emu, long checkpointInterval,
+		long maxInstructions, recording_t *rec) {
+	if (!emu->isLoaded || checkpointInterval <= 0) {
+		return -2;
+	}
+	// Snapshots copy all of memory, so streamed code has to be in it already
+	if (emu->stream != NULL && stream_load_all(emu->stream) < 0) {
+		return -2;
+	}
+	memset(rec, 0, sizeof(recording_t));
+	rec->stackSize = emu->stackSize;
+	rec->isTimed = emu->timing != NULL;
+	rec->checkpointInterval = checkpointInterval;
+
+	long *words = malloc(snapshot_size(emu->stackSize) * sizeof(long));
+	unsigned char *buffer = malloc(
+			COMPRESS_BOUND(snapshot_size(emu->stackSize)));
+	if (words == NULL || buffer == NULL
+			|| add_checkpoint(rec, emu, words, buffer) < 0) {
+		free(words);
+		free(buffer);
+		return -2;
+	}
+
+	long start = emu->instructionsRetired;
+	int status = 1;
+	while (status == 1) {
+		long chunk = checkpointInterval;
+		if (maxInstructions >= 0) {
+			long left = maxInstructions - (emu->instructionsRetired - start);
+			if (left <= 0) {
+				break;
+			}
+			if (left < chunk) {
+				chunk = left;
+			}
+		}
+		status = emulator_run(emu, chunk);
+		if (status == 1 && (emu->instructionsRetired - start)
+				% checkpointInterval == 0
+				&& add_checkpoint(rec, emu, words, buffer) < 0) {
+			status = -2;
+		}
+	}
+	rec->instructionCount = emu->instructionsRetired;
+	rec->status = status;
+
+	free(words);
+	free(buffer);
+	return status;
+}
+
+int replay_seek(const recording_t *rec, long instructionCount,
+		emulator_t *emu, int *status) {
+	// intl 3 reads the model's counters, so it has to be there (or not) like it was when recorded
+	if (rec->numCheckpoints == 0 || emu->stackSize != rec->stackSize
+			|| rec->isTimed != (emu->timing != NULL)
+			|| instructionCount < rec->checkpoints[0].instructionCount
+			|| instructionCount > rec->instructionCount) {
+		return -1; // nothing past the end of the recording was ever executed
+	}
+
+	// Checkpoints are in order, find the last one that isn't past instructionCount
+	long low = 0, high = rec->numCheckpoints - 1;
+	while (low < high) {
+		long mid = (low + high + 1) / 2;
+		if (rec->checkpoints[mid].instructionCount <= instructionCount) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+	const checkpoint_t *checkpoint = &rec->checkpoints[low];
+
+	long *words = malloc(snapshot_size(rec->stackSize) * sizeof(long));
+	if (words == NULL) {
+		return -1;
+	}
+	if (decompress_words(checkpoint->data, checkpoint->size, words,
+			snapshot_size(rec->stackSize)) != snapshot_size(rec->stackSize)) {
+		free(words);
+		return -1;
+	}
+	stream_close(emu); // the checkpoint has all of the code, don't let the prefetcher overwrite it
+	restore(words, emu);
+	free(words);
+
+	// The guest already printed all of this (and the trace and faults) when it was recorded
+	FILE *console = emu->console;
+	bool isQuiet = emu->isQuiet;
+	emu->console = NULL;
+	emu->isQuiet = true;
+	int runStatus = emulator_run(emu,
+			instructionCount - checkpoint->instructionCount);
+	if (runStatus == 1 && instructionCount == rec->instructionCount
+			&& rec->status == -1) {
+		// The fault that ended the recording didn't retire anything, take it again so emu ends up
+		// halted with the same err_reg
+		runStatus = emulator_run(emu, 1);
+	}
+	emu->console = console;
+	emu->isQuiet = isQuiet;
+	if (status != NULL) {
+		*status = runStatus;
+	}
+	return 0;
+}
+
+// Format: magic, the recording_t numbers (status included), then [instruction count] [size] [data] per checkpoint
+int replay_save(const recording_t *rec, FILE *out) {
+	long header[6] = { rec->stackSize, rec->checkpointInterval,
+			rec->instructionCount, rec->numCheckpoints, rec->isTimed,
+			rec->status };
+	if (fwrite(REPLAY_MAGIC, 1, 8, out) != 8
+			|| fwrite(header, sizeof(long), 6, out) != 6) {
+		return -1;
+	}
+	for (long i = 0; i < rec->numCheckpoints; i++) {
+		const checkpoint_t *checkpoint = &rec->checkpoints[i];
+		if (fwrite(&checkpoint->instructionCount, sizeof(long), 1, out) != 1
+				|| fwrite(&checkpoint->size, sizeof(size_t), 1, out) != 1
+				|| fwrite(checkpoint->data, 1, checkpoint->size, out)
+						!= checkpoint->size) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int replay_load(FILE *in, recording_t *rec) {
+	char magic[8];
+	long header[6];
+	memset(rec, 0, sizeof(recording_t));
+	if (fread(magic, 1, 8, in) != 8 || memcmp(magic, REPLAY_MAGIC, 8) != 0
+			|| fread(header, sizeof(long), 6, in) != 6 || header[0] <= 0
+			|| header[3] < 0) {
+		return -1;
+	}
+	rec->stackSize = header[0];
+	rec->checkpointInterval = header[1];
+	rec->instructionCount = header[2];
+	rec->isTimed = header[4] != 0;
+	rec->status = (int) header[5];
+
+	rec->checkpoints = calloc(header[3] > 0 ? header[3] : 1,
+			sizeof(checkpoint_t));
+	if (rec->checkpoints == NULL) {
+		return -1;
+	}
+	rec->maxCheckpoints = header[3];
+	for (long i = 0; i < header[3]; i++) {
+		checkpoint_t *checkpoint = &rec->checkpoints[i];
+		if (fread(&checkpoint->instructionCount, sizeof(long), 1, in) != 1
+				|| fread(&checkpoint->size, sizeof(size_t), 1, in) != 1
+				|| checkpoint->size
+						> COMPRESS_BOUND(snapshot_size(rec->stackSize))) {
+			replay_free(rec);
+			return -1;
+		}
+		checkpoint->data = malloc(checkpoint->size);
+		rec->numCheckpoints++;
+		if (checkpoint->data == NULL
+				|| fread(checkpoint->data, 1, checkpoint->size, in)
+						!= checkpoint->size) {
+			replay_free(rec);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void replay_free(recording_t *rec) {
+	for (long i = 0; i < rec->numCheckpoints; i++) {
+		free(rec->checkpoints[i].data);
+	}
+	free(rec->checkpoints);
+	rec->checkpoints = NULL;
+	rec->numCheckpoints = rec->maxCheckpoints = 0;
+}
+
+// Registers first, then the timing model, the stack and the push/pop memory
+static long snapshot_size(long stackSize) {
+	return REPLAY_NUM_REGS + REPLAY_TIMING_WORDS + stackSize
+			+ EMULATOR_SPECIAL_MEM_SIZE(stackSize);
+}
+
+static void snapshot(const emulator_t *emu, long *words) {
+	long regs[REPLAY_NUM_REGS] = { emu->nop_reg, emu->a_reg, emu->b_reg,
+			emu->c_reg, emu->d_reg, emu->err_reg, emu->stack_reg,
+			emu->base_reg, emu->x_special_reg, emu->specialMemCounter,
+			emu->instructionCounter, emu->instructionsRetired, emu->isLoaded,
+			emu->isHalted };
+	memcpy(words, regs, sizeof(regs));
+	words += REPLAY_NUM_REGS;
+	if (emu->timing != NULL) {
+		snapshot_timing(emu->timing, words);
+	} else {
+		memset(words, 0, REPLAY_TIMING_WORDS * sizeof(long));
+	}
+	words += REPLAY_TIMING_WORDS;
+	memcpy(words, emu->stack, emu->stackSize * sizeof(long));
+	memcpy(words + emu->stackSize, emu->specialMem,
+			EMULATOR_SPECIAL_MEM_SIZE(emu->stackSize) * sizeof(long));
+}
+
+static void restore(const long *words, emulator_t *emu) {
+	emu->nop_reg = words[0];
+	emu->a_reg = words[1];
+	emu->b_reg = words[2];
+	emu->c_reg = words[3];
+	emu->d_reg = words[4];
+	emu->err_reg = words[5];
+	emu->stack_reg = words[6];
+	emu->base_reg = words[7];
+	emu->x_special_reg = words[8];
+	emu->specialMemCounter = words[9];
+	emu->instructionCounter = words[10];
+	emu->instructionsRetired = words[11];
+	emu->isLoaded = words[12];
+	emu->isHalted = words[13];
+	words += REPLAY_NUM_REGS;
+	if (emu->timing != NULL) {
+		restore_timing(words, emu->timing);
+	}
+	words += REPLAY_TIMING_WORDS;
+	memcpy(emu->stack, words, emu->stackSize * sizeof(long));
+	memcpy(emu->specialMem, words + emu->stackSize,
+			EMULATOR_SPECIAL_MEM_SIZE(emu->stackSize) * sizeof(long));
+}
+
+static void snapshot_timing(const timing_model_t *model, long *words) {
+	memcpy(words, model->opcodeCycles, sizeof(model->opcodeCycles));
+	words += TIMING_NUM_OPCODES;
+	*words++ = model->cacheMissCycles;
+	*words++ = model->mispredictCycles;
+	*words++ = model->cycles;
+	*words++ = model->cacheMisses;
+	*words++ = model->branchMispredicts;
+	memcpy(words, model->cacheTags, sizeof(model->cacheTags));
+	words += TIMING_CACHE_LINES;
+	for (int i = 0; i < TIMING_PREDICTOR_SIZE; i++) {
+		words[i] = model->branchCounters[i];
+	}
+}
+
+static void restore_timing(const long *words, timing_model_t *model) {
+	memcpy(model->opcodeCycles, words, sizeof(model->opcodeCycles));
+	words += TIMING_NUM_OPCODES;
+	model->cacheMissCycles = *words++;
+	model->mispredictCycles = *words++;
+	model->cycles = *words++;
+	model->cacheMisses = *words++;
+	model->branchMispredicts = *words++;
+	memcpy(model->cacheTags, words, sizeof(model->cacheTags));
+	words += TIMING_CACHE_LINES;
+	for (int i = 0; i < TIMING_PREDICTOR_SIZE; i++) {
+		model->branchCounters[i] = (unsigned char) words[i];
+	}
+}
+
+static int add_checkpoint(recording_t *rec, const emulator_t *emu,
+		long *words, unsigned char *buffer) {
+	if (rec->numCheckpoints == rec->maxCheckpoints) {
+		long maxCheckpoints = rec->maxCheckpoints == 0 ?
+				16 : rec->maxCheckpoints * 2;
+		checkpoint_t *checkpoints = realloc(rec->checkpoints,
+				maxCheckpoints * sizeof(checkpoint_t));
+		if (checkpoints == NULL) {
+			return -1;
+		}
+		rec->checkpoints = checkpoints;
+		rec->maxCheckpoints = maxCheckpoints;
+	}
+
+	snapshot(emu, words);
+	size_t size = compress_words(words, snapshot_size(emu->stackSize), buffer);
+	unsigned char *data = malloc(size);
+	if (data == NULL) {
+		return -1;
+	}
+	memcpy(data, buffer, size);
+
+	checkpoint_t *checkpoint = &rec->checkpoints[rec->numCheckpoints++];
+	checkpoint->instructionCount = emu->instructionsRetired;
+	checkpoint->size = size;
+	checkpoint->data = data;
+	return 0;
+}
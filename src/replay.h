@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * replay.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdio.h>
+
+#include "emulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	long instructionCount; // instructionsRetired when the checkpoint was taken
+	size_t size;
+	unsigned char *data; // compressed registers + memory
+} checkpoint_t;
+
+typedef struct {
+	long stackSize;
+	bool isTimed; // a timing model was attached, its state is in every checkpoint
+	long checkpointInterval;
+	long instructionCount; // how far the recording got
+	int status; // what replay_record() returned
+
+	checkpoint_t *checkpoints; // the first one is the initial state
+	long numCheckpoints;
+	long maxCheckpoints;
+} recording_t;
+
+/*
+ * Runs the already loaded program for at most maxInstructions instructions (no limit if negative)
+ * and takes a compressed checkpoint every checkpointInterval instructions.
+ * Returns what the last emulator_run() returned or -2 if the recording itself failed
+ */
+int replay_record(emulator_t *emu, long checkpointInterval,
+		long maxInstructions, recording_t *rec);
+/*
+ * Puts emu in the state it had after instructionCount instructions by restoring the closest
+ * checkpoint before it and running the rest (quietly and with the console turned off).
+ * Returns -1 if instructionCount is outside of the recording, or if emu has a timing model and
+ * the recording doesn't (or the other way around). Otherwise the seek worked and status (can be
+ * NULL) gets what emulator_run() returned, so a fault the guest had is not a failed seek
+ */
+int replay_seek(const recording_t *rec, long instructionCount,
+		emulator_t *emu, int *status);
+int replay_save(const recording_t *rec, FILE *out);
+int replay_load(FILE *in, recording_t *rec);
+void replay_free(recording_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * stream.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "emulator.h"
+#include "stream.h"
+
+static void* prefetch(void *arg);
+static int index_pages(stream_t *stream, long page);
+static const char* window_at(stream_t *stream, long offset, size_t *available);
+static long read_word(stream_t *stream, long offset, unsigned long *word);
+static int load_page_locked(stream_t *stream, long page);
+static void free_stream(stream_t *stream);
+
+int stream_open(emulator_t *emu, bool usePrefetcher) {
+	return stream_open_paged(emu, usePrefetcher, STREAM_PAGE_SHIFT);
+}
+
+int stream_open_paged(emulator_t *emu, bool usePrefetcher, int pageShift) {
+	if (emu->hdd == NULL || emu->stream != NULL || emu->stack_reg != 0
+			|| pageShift < 0 || pageShift > 20) {
+		return -1;
+	}
+	long start = ftell(emu->hdd);
+
+	// Same header as programToMem() reads, plus the offset of the last instruction
+	unsigned long operation, numLines, lastLineOffset, operand2;
+	if (fscanf(emu->hdd, "%lx %lx %lx %lx", &operation, &numLines,
+			&lastLineOffset, &operand2) != 4
+			|| numLines > (unsigned long) emu->stackSize / 4) {
+		fseek(emu->hdd, start, SEEK_SET);
+		return -1;
+	}
+
+	stream_t *stream = calloc(1, sizeof(stream_t));
+	if (stream == NULL) {
+		fseek(emu->hdd, start, SEEK_SET);
+		return -1;
+	}
+	stream->hdd = emu->hdd;
+	stream->stack = emu->stack;
+	stream->numWords = numLines * 4;
+	stream->pageShift = pageShift;
+	stream->numPages = (stream->numWords + (1L << pageShift) - 1) >> pageShift;
+	stream->scanOffset = ftell(emu->hdd);
+	stream->isResident = calloc(stream->numPages + 1, sizeof(atomic_uchar));
+	stream->pageOffsets = malloc((stream->numPages + 1) * sizeof(long));
+	stream->window = malloc(STREAM_WINDOW_SIZE);
+	if (stream->isResident == NULL || stream->pageOffsets == NULL
+			|| stream->window == NULL
+			|| start < 0 || stream->scanOffset < 0) {
+		free_stream(stream);
+		fseek(emu->hdd, start, SEEK_SET);
+		return -1;
+	}
+	pthread_mutex_init(&stream->lock, NULL);
+	atomic_init(&stream->isStopping, false);
+
+	// The loader leaves the last instruction in a, b, c and d
+	unsigned long last[4] = { 0, 0, 0, 0 };
+	int result = 0;
+	if (numLines > 0 && lastLineOffset > 0) {
+		long offset = start + (long) lastLineOffset;
+		for (int i = 0; i < 4 && offset >= 0; i++) {
+			offset = read_word(stream, offset, &last[i]);
+		}
+		result = offset < 0 ? -1 : 0;
+	} else if (numLines > 0) {
+		result = stream_fault(stream, stream->numWords - 4, 4);
+		for (int i = 0; i < 4; i++) {
+			last[i] = (unsigned long) emu->stack[stream->numWords - 4 + i];
+		}
+	}
+	if (result < 0) {
+		pthread_mutex_destroy(&stream->lock);
+		free_stream(stream);
+		fseek(emu->hdd, start, SEEK_SET);
+		return -1;
+	}
+	if (numLines > 0) {
+		emu->a_reg = (long) last[0];
+		emu->b_reg = (long) last[1];
+		emu->c_reg = (long) last[2];
+		emu->d_reg = (long) last[3];
+	}
+	emu->stack_reg = stream->numWords;
+	emu->isLoaded = true;
+	emu->stream = stream;
+
+	if (usePrefetcher && stream->numPages > 1) {
+		stream->hasPrefetcher = pthread_create(&stream->prefetcher, NULL,
+				prefetch, stream) == 0;
+	}
+	return 0;
+}
+
+void stream_close(emulator_t *emu) {
+	stream_t *stream = emu->stream;
+	if (stream == NULL) {
+		return;
+	}
+	if (stream->hasPrefetcher) {
+		atomic_store(&stream->isStopping, true);
+		pthread_join(stream->prefetcher, NULL);
+	}
+	pthread_mutex_destroy(&stream->lock);
+	free_stream(stream);
+	emu->stream = NULL;
+}
+
+int stream_load_page(stream_t *stream, long page) {
+	pthread_mutex_lock(&stream->lock);
+	int result = 0;
+	if (!atomic_load_explicit(&stream->isResident[page],
+			memory_order_relaxed)) {
+		result = load_page_locked(stream, page);
+	}
+	pthread_mutex_unlock(&stream->lock);
+	return result;
+}
+
+int stream_load_all(stream_t *stream) {
+	return stream->numWords == 0 ? 0 : stream_fault(stream, 0, stream->numWords);
+}
+
+// Walks ahead of the cpu so most pages (and the index) are already there by the time they are needed
+static void* prefetch(void *arg) {
+	stream_t *stream = arg;
+	for (long page = 0; page < stream->numPages; page++) {
+		if (atomic_load_explicit(&stream->isStopping, memory_order_relaxed)) {
+			break;
+		}
+		if (!atomic_load_explicit(&stream->isResident[page],
+				memory_order_acquire) && stream_load_page(stream, page) < 0) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+// Goes on from where the index stopped until it knows where page starts, without parsing anything
+static int index_pages(stream_t *stream, long page) {
+	long pageWords = 1L << stream->pageShift;
+	while (stream->numIndexedPages <= page) {
+		size_t size;
+		const char *buffer = window_at(stream, stream->scanOffset, &size);
+		if (buffer == NULL) {
+			return -1; // the hdd ends before the program does
+		}
+		size_t i = 0;
+		for (; i < size && stream->numScannedWords < stream->numWords; i++) {
+			bool isSpace = isspace((unsigned char) buffer[i]);
+			if (!isSpace && !stream->isInWord) {
+				if ((stream->numScannedWords & (pageWords - 1)) == 0) {
+					stream->pageOffsets[stream->numIndexedPages++] =
+							stream->scanOffset + i;
+				}
+				stream->numScannedWords++;
+			}
+			stream->isInWord = !isSpace;
+		}
+		stream->scanOffset += i;
+		if (stream->numScannedWords == stream->numWords
+				&& stream->numIndexedPages <= page) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int load_page_locked(stream_t *stream, long page) {
+	long first = page << stream->pageShift;
+	long numWords = stream->numWords - first;
+	if (numWords > 1L << stream->pageShift) {
+		numWords = 1L << stream->pageShift;
+	}
+
+	if (index_pages(stream, page) < 0) {
+		return -1;
+	}
+	long offset = stream->pageOffsets[page];
+	for (long i = 0; i < numWords; i++) {
+		unsigned long word;
+		if ((offset = read_word(stream, offset, &word)) < 0) {
+			return -1;
+		}
+		stream->stack[first + i] = (long) word;
+	}
+	atomic_store_explicit(&stream->isResident[page], 1, memory_order_release);
+	return 0;
+}
+
+/*
+ * Returns the hdd from offset on (at least STREAM_MAX_WORD_SIZE bytes of it unless the hdd ends
+ * first), reading it into the window if it isn't there yet. NULL at the end of the hdd
+ */
+static const char* window_at(stream_t *stream, long offset, size_t *available) {
+	long end = stream->windowOffset + (long) stream->windowSize;
+	if (offset < stream->windowOffset || offset >= end
+			|| (end - offset < STREAM_MAX_WORD_SIZE
+					&& stream->windowSize == STREAM_WINDOW_SIZE)) {
+		if (fseek(stream->hdd, offset, SEEK_SET) != 0) {
+			return NULL;
+		}
+		stream->windowOffset = offset;
+		stream->windowSize = fread(stream->window, 1, STREAM_WINDOW_SIZE,
+				stream->hdd);
+		end = offset + (long) stream->windowSize;
+		if (stream->windowSize == 0) {
+			return NULL;
+		}
+	}
+	*available = end - offset;
+	return stream->window + (offset - stream->windowOffset);
+}
+
+// Like fscanf(hdd, "%lx"), returns where the word ends or -1
+static long read_word(stream_t *stream, long offset, unsigned long *word) {
+	size_t available;
+	const char *text;
+	while ((text = window_at(stream, offset, &available)) != NULL
+			&& isspace((unsigned char) text[0])) {
+		offset++;
+	}
+	if (text == NULL) {
+		return -1;
+	}
+
+	unsigned long value = 0;
+	size_t i = 0;
+	for (; i < available && i < STREAM_MAX_WORD_SIZE; i++) {
+		char c = text[i];
+		if (c >= '0' && c <= '9') {
+			value = (value << 4) | (c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			value = (value << 4) | (c - 'a' + 10);
+		} else if (c >= 'A' && c <= 'F') {
+			value = (value << 4) | (c - 'A' + 10);
+		} else {
+			break;
+		}
+	}
+	if (i == 0 || i == STREAM_MAX_WORD_SIZE) {
+		return -1;
+	}
+	*word = value;
+	return offset + (long) i;
+}
+
+static void free_stream(stream_t *stream) {
+	free(stream->window);
+	free(stream->isResident);
+	free(stream->pageOffsets);
+	free(stream);
+}
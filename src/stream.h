@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * stream.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "emulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAM_PAGE_SHIFT 10
+#define STREAM_PAGE_WORDS (1L << STREAM_PAGE_SHIFT)
+#define STREAM_WINDOW_SIZE (1 << 16) // bytes of the hdd read at once
+#define STREAM_MAX_WORD_SIZE 64 // longer words than this (leading zeros) can't be streamed
+
+/*
+ * Lazily loads the code of an hdd image a page at a time: a page is read the first time the cpu
+ * touches it, and (optionally) a background thread reads ahead of it. Words in the hdd aren't
+ * all the same width (negative values take 16 digits), so where a page starts is only known
+ * after going over everything before it. That index is built as pages get asked for: a page-in
+ * picks up where the last one stopped, and the prefetcher keeps it ahead of the cpu
+ */
+typedef struct stream_s {
+	FILE *hdd;
+	long *stack;
+	long numWords; // how many words of code there are
+	long numPages;
+	int pageShift; // log2 of the words per page
+
+	// Page index, guarded by lock
+	long *pageOffsets; // where each page starts in the hdd
+	long numIndexedPages;
+	long scanOffset; // where indexing goes on from
+	long numScannedWords;
+	bool isInWord;
+
+	// The part of the hdd that was read last, so neighbouring page-ins don't go back to the file
+	char *window;
+	long windowOffset;
+	size_t windowSize;
+
+	atomic_uchar *isResident; // one per page
+	pthread_mutex_t lock; // guards hdd, the page index and the window
+
+	pthread_t prefetcher;
+	bool hasPrefetcher;
+	atomic_bool isStopping;
+} stream_t;
+
+/*
+ * Use this instead of letting emulator_start() read the whole hdd. Only the header and the last
+ * instruction are read right away, the registers end up like the normal loader leaves them.
+ * The last instruction is found through the offset assemble() puts in the header; hdds without
+ * it have to be indexed to the end first. On failure the hdd is left where it was, so the
+ * normal loader can still be used
+ */
+int stream_open(emulator_t *emu, bool usePrefetcher);
+/*
+ * Same as stream_open() with pages of 1 << pageShift words (small pages are for tests)
+ */
+int stream_open_paged(emulator_t *emu, bool usePrefetcher, int pageShift);
+void stream_close(emulator_t *emu);
+int stream_load_page(stream_t *stream, long page);
+int stream_load_all(stream_t *stream);
+
+/*
+ * Makes sure the numWords words at address are in memory, returns -1 if the hdd couldn't be read
+ */
+static inline int stream_fault(stream_t *stream, long address, long numWords) {
+	long lastPage = (address + numWords - 1) >> stream->pageShift;
+	if (lastPage >= stream->numPages) {
+		lastPage = stream->numPages - 1;
+	}
+	for (long page = address >> stream->pageShift; page <= lastPage; page++) {
+		if (!atomic_load_explicit(&stream->isResident[page],
+				memory_order_acquire) && stream_load_page(stream, page) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_H_ */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * timing.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "timing.h"
+
+static void access_cache(timing_model_t *model, long address);
+static void predict_branch(timing_model_t *model, long pc, bool isTaken);
+
+void timing_init(timing_model_t *model) {
+	for (int i = 0; i < TIMING_NUM_OPCODES; i++) {
+		model->opcodeCycles[i] = 1;
+	}
+	model->opcodeCycles[STMOVL_INSTR] = 2;
+	model->opcodeCycles[IMUL_INSTR] = 3;
+	model->opcodeCycles[IDIVL_INSTR] = 20;
+	model->opcodeCycles[PUSHL_INSTR] = 2;
+	model->opcodeCycles[POPL_INSTR] = 2;
+	model->opcodeCycles[INTL_INSTR] = 50;
+	model->cacheMissCycles = 10;
+	model->mispredictCycles = 8;
+	timing_reset(model);
+}
+
+void timing_reset(timing_model_t *model) {
+	for (int i = 0; i < TIMING_CACHE_LINES; i++) {
+		model->cacheTags[i] = -1;
+	}
+	memset(model->branchCounters, 1, sizeof(model->branchCounters)); // weakly not taken
+	model->cycles = 0;
+	model->cacheMisses = 0;
+	model->branchMispredicts = 0;
+}
+
+void timing_account(timing_model_t *model, long opcode, long pc, bool isTaken,
+		long dataAddress) {
+	// Bad opcodes still cost something (the cpu has to fault on them)
+	model->cycles += opcode >= 0 && opcode < TIMING_NUM_OPCODES ?
+			model->opcodeCycles[opcode] : 1;
+
+	access_cache(model, pc);
+	if (dataAddress >= 0) {
+		access_cache(model, dataAddress);
+	}
+
+	switch (opcode) {
+	case JE_INSTR:
+	case JL_INSTR:
+	case JG_INSTR:
+	case JLE_INSTR:
+	case JGE_INSTR:
+		predict_branch(model, pc, isTaken);
+		break;
+	}
+}
+
+static void access_cache(timing_model_t *model, long address) {
+	long line = address / TIMING_CACHE_LINE_WORDS;
+	long index = line % TIMING_CACHE_LINES;
+	if (model->cacheTags[index] != line) {
+		model->cacheTags[index] = line;
+		model->cacheMisses++;
+		model->cycles += model->cacheMissCycles;
+	}
+}
+
+static void predict_branch(timing_model_t *model, long pc, bool isTaken) {
+	unsigned char *counter = &model->branchCounters[(pc / 4)
+			% TIMING_PREDICTOR_SIZE];
+	if ((*counter >= 2) != isTaken) {
+		model->branchMispredicts++;
+		model->cycles += model->mispredictCycles;
+	}
+	if (isTaken && *counter < 3) {
+		(*counter)++;
+	} else if (!isTaken && *counter > 0) {
+		(*counter)--;
+	}
+}
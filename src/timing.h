@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021, suncloudsmoon and the Dirt Emulator contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * timing.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Dirt Emulator contributors
+ */
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIMING_NUM_OPCODES 0x17 // INTL_INSTR + 1
+#define TIMING_CACHE_LINES 64
+#define TIMING_CACHE_LINE_WORDS 8
+#define TIMING_PREDICTOR_SIZE 256
+
+/*
+ * A simple model of what the guest would cost on a real cpu: a cycle cost per opcode, a direct
+ * mapped cache in front of the stack (instruction fetches and stmovl) and a 2-bit branch predictor.
+ * Attach one to emulator_t.timing to turn it on; with NULL the run loop skips all of this.
+ * Everything lives inside the struct, so it can be embedded without any malloc.
+ * Replay checkpoints include all of it, so the counters after a seek match the recorded run.
+ */
+typedef struct timing_model_s {
+	// Costs (change them after timing_init() to model a different cpu)
+	long opcodeCycles[TIMING_NUM_OPCODES];
+	long cacheMissCycles;
+	long mispredictCycles;
+
+	// State
+	long cacheTags[TIMING_CACHE_LINES];
+	unsigned char branchCounters[TIMING_PREDICTOR_SIZE]; // 0-1 not taken, 2-3 taken
+
+	// Counters
+	long cycles;
+	long cacheMisses;
+	long branchMispredicts;
+} timing_model_t;
+
+/*
+ * Fills in the default costs and resets everything else
+ */
+void timing_init(timing_model_t *model);
+/*
+ * Clears the counters, the cache and the predictor but keeps the costs
+ */
+void timing_reset(timing_model_t *model);
+/*
+ * Charges one executed instruction at pc. dataAddress is the stack word it wrote or -1
+ */
+void timing_account(timing_model_t *model, long opcode, long pc, bool isTaken,
+		long dataAddress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMING_H_ */